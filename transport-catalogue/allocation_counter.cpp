@@ -0,0 +1,115 @@
+#include "allocation_counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace profiler {
+
+	namespace {
+		// Тривиальный тип: thread_local без динамической инициализации безопасен внутри operator new
+		thread_local AllocationStatistics thread_allocations;
+		// Инициализируется константой, поэтому готов и для выделений до main
+		std::atomic<bool> is_counting_enabled{ false };
+
+		void CountAllocation(std::size_t size) {
+			if (!is_counting_enabled.load(std::memory_order_relaxed)) {
+				return;
+			}
+			++thread_allocations.allocations;
+			thread_allocations.bytes += size;
+		}
+
+		void* Allocate(std::size_t size) {
+			CountAllocation(size);
+			return std::malloc(size == 0 ? 1 : size);
+		}
+
+		void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+			CountAllocation(size);
+			const auto alignment_value = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+			// aligned_alloc требует размер, кратный выравниванию
+			const std::size_t aligned_size = (std::max<std::size_t>(size, 1) + alignment_value - 1) / alignment_value * alignment_value;
+			return std::aligned_alloc(alignment_value, aligned_size);
+		}
+	}
+
+	AllocationStatistics GetThreadAllocations() {
+		return thread_allocations;
+	}
+
+	void EnableAllocationCounting() {
+		is_counting_enabled.store(true, std::memory_order_relaxed);
+	}
+}
+
+void* operator new(std::size_t size) {
+	if (void* pointer = profiler::Allocate(size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return profiler::Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return profiler::Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	if (void* pointer = profiler::AllocateAligned(size, alignment)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return profiler::AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return profiler::AllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
\ No newline at end of file
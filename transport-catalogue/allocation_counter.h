@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+namespace profiler {
+
+	struct AllocationStatistics {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+	};
+
+	// Число выделений памяти и запрошенных байт в вызывающем потоке с включения подсчёта.
+	// Счётчики ведут заменённые глобальные operator new из allocation_counter.cpp;
+	// разность двух замеров даёт выделения за интервал
+	AllocationStatistics GetThreadAllocations();
+
+	// Включает подсчёт выделений; до этого operator new проверяет только один флаг.
+	// Подсчёт остаётся включённым до конца работы программы
+	void EnableAllocationCounting();
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "async_input.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace async_input {
+
+	namespace {
+		[[noreturn]] void ThrowSystemError(const char* operation) {
+			throw std::system_error(errno, std::generic_category(), operation);
+		}
+	}
+
+	ReadBuffer::ReadBuffer(int fd, ReadBufferSettings settings)
+		:fd_(fd), capacity_((settings.buffer_size + settings.alignment - 1) / settings.alignment * settings.alignment)
+	{
+		for (Buffer& buffer : buffers_) {
+			buffer.data = { static_cast<char*>(std::aligned_alloc(settings.alignment, capacity_)), &std::free };
+			if (!buffer.data) {
+				throw std::bad_alloc();
+			}
+		}
+		if (pipe2(stop_pipe_, O_CLOEXEC) < 0) {
+			ThrowSystemError("pipe2");
+		}
+		reader_ = std::thread(&ReadBuffer::ReadLoop, this);
+	}
+
+	ReadBuffer::~ReadBuffer() {
+		{
+			std::lock_guard guard(mutex_);
+			is_stopping_ = true;
+		}
+		buffer_changed_.notify_all();
+		const char stop_signal = 0;
+		while (write(stop_pipe_[1], &stop_signal, 1) < 0 && errno == EINTR) {
+		}
+		reader_.join();
+		close(stop_pipe_[0]);
+		close(stop_pipe_[1]);
+	}
+
+	size_t ReadBuffer::GetStallsCount() const {
+		std::lock_guard guard(mutex_);
+		return stalls_count_;
+	}
+
+	ReadBuffer::int_type ReadBuffer::underflow() {
+		if (gptr() < egptr()) {
+			return traits_type::to_int_type(*gptr());
+		}
+		std::unique_lock lock(mutex_);
+		if (is_consuming_) {
+			buffers_[consumed_index_].is_filled = false;
+			is_consuming_ = false;
+			setg(nullptr, nullptr, nullptr);
+			buffer_changed_.notify_all();
+		}
+
+		// Поток чтения заполняет буферы по очереди, поэтому следующий по порядку буфер - всегда другой
+		Buffer& next = buffers_[consumed_index_ ^ 1];
+		if (!next.is_filled && !is_end_of_input_) {
+			++stalls_count_;
+			buffer_changed_.wait(lock, [this, &next] { return next.is_filled || is_end_of_input_; });
+		}
+		if (!next.is_filled) {
+			if (error_code_ != 0) {
+				throw std::system_error(error_code_, std::generic_category(), "read");
+			}
+			return traits_type::eof();
+		}
+		consumed_index_ ^= 1;
+		is_consuming_ = true;
+		setg(next.data.get(), next.data.get(), next.data.get() + next.size);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	std::streamsize ReadBuffer::showmanyc() {
+		std::lock_guard guard(mutex_);
+		const Buffer& next = buffers_[consumed_index_ ^ 1];
+		if (next.is_filled) {
+			return static_cast<std::streamsize>(next.size);
+		}
+		return is_end_of_input_ ? -1 : 0;
+	}
+
+	void ReadBuffer::ReadLoop() {
+		size_t index = 0;
+		bool is_end = false;
+		while (!is_end) {
+			Buffer& buffer = buffers_[index];
+			{
+				std::unique_lock lock(mutex_);
+				buffer_changed_.wait(lock, [this, &buffer] { return !buffer.is_filled || is_stopping_; });
+				if (is_stopping_) {
+					return;
+				}
+			}
+			int error_code = 0;
+			if (!Fill(buffer, is_end, error_code)) {
+				return;
+			}
+			{
+				std::lock_guard guard(mutex_);
+				buffer.is_filled = buffer.size > 0;
+				is_end = is_end || error_code != 0;
+				is_end_of_input_ = is_end;
+				error_code_ = error_code;
+			}
+			buffer_changed_.notify_all();
+			index ^= 1;
+		}
+	}
+
+	bool ReadBuffer::Fill(Buffer& buffer, bool& is_end, int& error_code) {
+		buffer.size = 0;
+		while (buffer.size < capacity_) {
+			// Первое чтение ждёт данных сколько угодно, следующие берут только уже готовые
+			pollfd descriptors[2] = { { fd_, POLLIN, 0 }, { stop_pipe_[0], POLLIN, 0 } };
+			const int ready_count = poll(descriptors, 2, buffer.size == 0 ? -1 : 0);
+			if (ready_count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				error_code = errno;
+				return true;
+			}
+			if (descriptors[1].revents != 0) {
+				return false;
+			}
+			if (ready_count == 0) {
+				break;
+			}
+			const ssize_t read_size = read(fd_, buffer.data.get() + buffer.size, capacity_ - buffer.size);
+			if (read_size < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					break;
+				}
+				error_code = errno;
+				return true;
+			}
+			if (read_size == 0) {
+				is_end = true;
+				break;
+			}
+			buffer.size += static_cast<size_t>(read_size);
+		}
+		return true;
+	}
+
+	InputStream::InputStream(int fd, ReadBufferSettings settings)
+		:std::istream(nullptr), buffer_(fd, settings)
+	{
+		rdbuf(&buffer_);
+	}
+
+	const ReadBuffer& InputStream::GetBuffer() const {
+		return buffer_;
+	}
+}
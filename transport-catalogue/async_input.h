@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+
+namespace async_input {
+
+	struct ReadBufferSettings {
+		// Размер каждого из двух буферов; округляется вверх до кратного выравниванию
+		size_t buffer_size = 1 << 20;
+		size_t alignment = 4096;
+	};
+
+	// Буфер потока с двойной буферизацией: фоновый поток читает файловый дескриптор в один буфер,
+	// пока разбор потребляет другой, поэтому ожидание данных (например, от распаковщика на другом конце
+	// канала) и разбор идут одновременно.
+	// Поток чтения дочитывает буфер, пока в дескрипторе есть готовые данные, и сразу отдаёт его,
+	// когда их нет, поэтому построчный интерактивный ввод режима serve не задерживается.
+	// Ошибка чтения выдаётся из underflow как std::system_error, и std::istream ставит badbit
+	class ReadBuffer : public std::streambuf {
+	public:
+		explicit ReadBuffer(int fd, ReadBufferSettings settings = {});
+
+		ReadBuffer(const ReadBuffer&) = delete;
+		ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+		// Останавливает поток чтения, даже если он ждёт данных; дескриптор не закрывается
+		~ReadBuffer() override;
+
+		// Сколько раз разбор ждал, пока поток чтения заполнит следующий буфер
+		size_t GetStallsCount() const;
+
+	protected:
+		int_type underflow() override;
+
+		// Учитывает и уже прочитанный следующий буфер: в режиме serve по in_avail решается, пора ли сбрасывать ответы
+		std::streamsize showmanyc() override;
+
+	private:
+		struct Buffer {
+			std::unique_ptr<char, void (*)(void*)> data{ nullptr, nullptr };
+			size_t size = 0;
+			bool is_filled = false;
+		};
+
+		int fd_;
+		size_t capacity_;
+		// Пара каналов, запись в который будит поток чтения при разрушении буфера
+		int stop_pipe_[2] = { -1, -1 };
+		Buffer buffers_[2];
+		// Буфер, который сейчас потребляет разбор; до первого underflow - ни одного
+		size_t consumed_index_ = 1;
+		bool is_consuming_ = false;
+
+		mutable std::mutex mutex_;
+		std::condition_variable buffer_changed_;
+		bool is_end_of_input_ = false;
+		bool is_stopping_ = false;
+		// errno ошибки чтения; после неё ввод считается законченным
+		int error_code_ = 0;
+		size_t stalls_count_ = 0;
+		std::thread reader_;
+
+		void ReadLoop();
+		// Читает в buffer, пока есть готовые данные и место; false - если чтение остановлено.
+		// При конце ввода ставит is_end, при ошибке - error_code
+		bool Fill(Buffer& buffer, bool& is_end, int& error_code);
+	};
+
+	// Поток ввода поверх ReadBuffer, который можно передать json::Load или json_reader::JsonReader
+	class InputStream : public std::istream {
+	public:
+		explicit InputStream(int fd, ReadBufferSettings settings = {});
+
+		const ReadBuffer& GetBuffer() const;
+
+	private:
+		ReadBuffer buffer_;
+	};
+}
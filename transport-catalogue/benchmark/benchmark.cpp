@@ -0,0 +1,213 @@
+// Замеры времени, памяти и числа выделений памяти по стадиям обработки на синтетических городах разного размера.
+// Сборка из каталога transport-catalogue:
+//   g++ -std=c++17 -O2 -pthread benchmark/*.cpp $(ls *.cpp | grep -v main.cpp) -o transport_catalogue_benchmark
+// Нужны все файлы, кроме main.cpp: json_reader подключает справочник, хранилище версий, сериализацию и отрисовку.
+// Запуск: transport_catalogue_benchmark [--seed N] [--requests N] [--stops-per-bus N] [--emit] [stops_count...]
+// С --emit сгенерированный вход печатается в stdout вместо замеров (годится как вход основной программы)
+
+#include "city_generator.h"
+#include "../allocation_counter.h"
+#include "../json.h"
+#include "../json_reader.h"
+#include "../map_renderer.h"
+#include "../request_handler.h"
+#include "../transport_catalogue.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+namespace {
+
+	// Текущий размер резидентной памяти процесса в байтах
+	size_t GetCurrentRss() {
+		std::ifstream statm("/proc/self/statm"s);
+		size_t total_pages = 0;
+		size_t resident_pages = 0;
+		statm >> total_pages >> resident_pages;
+		return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	size_t GetPeakRss() {
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+	}
+
+	class StageReporter {
+	public:
+		StageReporter(std::ostream& output, size_t scale)
+			:output_(output), scale_(scale)
+		{
+		}
+
+		// Выполняет стадию и печатает время, пропускную способность и память после неё
+		template <typename Stage>
+		void Run(std::string_view name, size_t items_count, Stage stage) {
+			const profiler::AllocationStatistics start_allocations = profiler::GetThreadAllocations();
+			const auto start = std::chrono::steady_clock::now();
+			stage();
+			const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			const profiler::AllocationStatistics allocations = profiler::GetThreadAllocations();
+			const double items_per_second = duration.count() > 0 ? static_cast<double>(items_count) / duration.count() : 0.0;
+			output_ << std::left << std::setw(10) << scale_ << std::setw(28) << name
+			        << std::right << std::setw(12) << items_count
+			        << std::setw(12) << std::fixed << std::setprecision(2) << duration.count() * 1000.0
+			        << std::setw(16) << std::setprecision(0) << items_per_second
+			        << std::setw(12) << std::setprecision(1) << static_cast<double>(GetCurrentRss()) / (1 << 20)
+			        << std::setw(12) << static_cast<double>(GetPeakRss()) / (1 << 20)
+			        << std::setw(12) << allocations.allocations - start_allocations.allocations
+			        << std::setw(12) << static_cast<double>(allocations.bytes - start_allocations.bytes) / (1 << 20) << std::endl;
+		}
+
+		static void PrintHeader(std::ostream& output) {
+			output << std::left << std::setw(10) << "stops"sv << std::setw(28) << "stage"sv
+			       << std::right << std::setw(12) << "items"sv << std::setw(12) << "ms"sv
+			       << std::setw(16) << "items/s"sv << std::setw(12) << "rss MB"sv
+			       << std::setw(12) << "peak MB"sv << std::setw(12) << "allocs"sv
+			       << std::setw(12) << "alloc MB"sv << std::endl;
+		}
+
+	private:
+		std::ostream& output_;
+		size_t scale_;
+	};
+
+	void RunBenchmark(const city_generator::CityConfig& config, std::ostream& output) {
+		StageReporter reporter(output, config.stops_count);
+
+		std::string input_text;
+		{
+			json::Document input = city_generator::GenerateCity(config);
+			std::ostringstream input_stream;
+			reporter.Run("json::Print (input)"sv, config.stops_count + config.buses_count, [&] {
+				json::Print(input, input_stream);
+			});
+			input_text = input_stream.str();
+		}
+
+		std::istringstream input_stream(input_text);
+		std::optional<json_reader::JsonReader> input_request;
+		reporter.Run("json::Load"sv, input_text.size(), [&] {
+			input_request.emplace(input_stream);
+		});
+
+		transport_catalogue::TransportCatalogue catalogue;
+		reporter.Run("AddStop"sv, config.stops_count, [&] {
+			input_request->AddStopsToTransportCatalogue(catalogue);
+		});
+		reporter.Run("AddBus"sv, config.buses_count, [&] {
+			input_request->AddBusesToTransportCatalogue(catalogue);
+		});
+		reporter.Run("AddDistanceBetweenStops"sv, config.stops_count, [&] {
+			input_request->AddDistancesBetweenStopsToTransportCatalogue(catalogue);
+		});
+		reporter.Run("BuildIndexes"sv, config.stops_count + config.buses_count, [&] {
+			catalogue.BuildIndexes();
+		});
+
+		double checksum = 0.0;
+		reporter.Run("GetBusInformation"sv, catalogue.GetBusesList().size(), [&] {
+			for (const auto& bus : catalogue.GetBusesList()) {
+				checksum += catalogue.GetBusInformation(&bus).curvature;
+			}
+		});
+		reporter.Run("GetBusesForStop"sv, catalogue.GetStopsList().size(), [&] {
+			for (const auto& stop : catalogue.GetStopsList()) {
+				checksum += static_cast<double>(catalogue.GetBusesForStop(stop.stop_name).size());
+			}
+		});
+
+		map_renderer::MapRender map_renderer(input_request->AddRenderingSettings());
+		request_handler::RequestHandler request_handler(catalogue, map_renderer);
+		reporter.Run("MapRender::CreateMap"sv, config.stops_count + config.buses_count, [&] {
+			std::ostringstream map_output;
+			request_handler.RenderMap().Render(map_output);
+			checksum += static_cast<double>(map_output.str().size());
+		});
+
+		reporter.Run("PrintStatistics"sv, config.stat_requests_count, [&] {
+			std::ostringstream statistics_output;
+			input_request->PrintStatistics(request_handler, catalogue, statistics_output);
+			checksum += static_cast<double>(statistics_output.str().size());
+		});
+
+		// Контрольная сумма не даёт компилятору выбросить замеряемую работу
+		std::cerr << "checksum "sv << checksum << std::endl;
+	}
+
+	void PrintUsage(std::ostream& stream = std::cerr) {
+		stream << "Usage: transport_catalogue_benchmark [--seed N] [--requests N] [--stops-per-bus N] [--emit] [stops_count...]\n"sv;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	city_generator::CityConfig base_config;
+	bool emit_input = false;
+	std::vector<size_t> scales;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string_view argument(argv[i]);
+			if (argument == "--help"sv) {
+				PrintUsage(std::cout);
+				return 0;
+			}
+			if (argument == "--emit"sv) {
+				emit_input = true;
+			}
+			else if (argument == "--seed"sv && i + 1 < argc) {
+				base_config.seed = std::stoull(argv[++i]);
+			}
+			else if (argument == "--requests"sv && i + 1 < argc) {
+				base_config.stat_requests_count = std::stoull(argv[++i]);
+			}
+			else if (argument == "--stops-per-bus"sv && i + 1 < argc) {
+				base_config.stops_per_bus = std::stoull(argv[++i]);
+			}
+			else if (!argument.empty() && argument.front() != '-') {
+				scales.push_back(std::stoull(argv[i]));
+			}
+			else {
+				PrintUsage();
+				return 1;
+			}
+		}
+	}
+	// std::stoull бросает std::invalid_argument и std::out_of_range на нечисловые и слишком большие значения
+	catch (const std::logic_error&) {
+		PrintUsage();
+		return 1;
+	}
+	if (scales.empty()) {
+		scales = { 1000, 10000, 100000 };
+	}
+
+	if (emit_input) {
+		city_generator::CityConfig config = base_config;
+		config.stops_count = scales.front();
+		config.buses_count = std::max<size_t>(config.stops_count / 10, 1);
+		json::Print(city_generator::GenerateCity(config), std::cout);
+		return 0;
+	}
+
+	profiler::EnableAllocationCounting();
+	StageReporter::PrintHeader(std::cout);
+	for (size_t scale : scales) {
+		city_generator::CityConfig config = base_config;
+		config.stops_count = scale;
+		config.buses_count = std::max<size_t>(scale / 10, 1);
+		RunBenchmark(config, std::cout);
+	}
+}
\ No newline at end of file
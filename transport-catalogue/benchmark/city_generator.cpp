@@ -0,0 +1,153 @@
+#include "city_generator.h"
+#include "../geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace city_generator {
+
+	using namespace std::literals;
+
+	namespace {
+		constexpr double CITY_CENTER_LAT = 55.75;
+		constexpr double CITY_CENTER_LNG = 37.62;
+		constexpr double GRID_STEP = 0.0027;
+
+		class Random {
+		public:
+			explicit Random(uint64_t seed)
+				:engine_(seed)
+			{
+			}
+
+			// Равномерно на [0, 1)
+			double NextDouble() {
+				return static_cast<double>(engine_() >> 11) * (1.0 / 9007199254740992.0);
+			}
+
+			size_t NextIndex(size_t bound) {
+				return static_cast<size_t>(NextDouble() * static_cast<double>(bound));
+			}
+
+		private:
+			std::mt19937_64 engine_;
+		};
+
+		std::string StopName(size_t index) {
+			return "Stop "s + std::to_string(index);
+		}
+
+		std::string BusName(size_t index) {
+			return "Bus "s + std::to_string(index);
+		}
+
+		json::Node CreateRenderSettings() {
+			return json::Dict{
+				{"width"s, 1200.0}, {"height"s, 1200.0}, {"padding"s, 50.0},
+				{"line_width"s, 14.0}, {"stop_radius"s, 5.0},
+				{"bus_label_font_size"s, 20}, {"bus_label_offset"s, json::Array{ 7.0, 15.0 }},
+				{"stop_label_font_size"s, 20}, {"stop_label_offset"s, json::Array{ 7.0, -3.0 }},
+				{"underlayer_color"s, json::Array{ 255, 255, 255, 0.85 }}, {"underlayer_width"s, 3.0},
+				{"color_palette"s, json::Array{ "green"s, json::Array{ 255, 160, 0 }, "red"s }}
+			};
+		}
+	}
+
+	json::Document GenerateCity(const CityConfig& config) {
+		Random random(config.seed);
+		const size_t stops_count = std::max<size_t>(config.stops_count, 2);
+		const size_t grid_side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(stops_count))));
+
+		std::vector<geo::Coordinates> coordinates(stops_count);
+		for (size_t i = 0; i < stops_count; ++i) {
+			coordinates[i] = { CITY_CENTER_LAT + (static_cast<double>(i / grid_side) + 0.4 * random.NextDouble()) * GRID_STEP,
+			                   CITY_CENTER_LNG + (static_cast<double>(i % grid_side) + 0.4 * random.NextDouble()) * GRID_STEP };
+		}
+
+		// Маршрут - блуждание по соседям в решётке без немедленного возврата на предыдущую остановку
+		std::vector<std::set<size_t>> road_neighbours(stops_count);
+		json::Array buses;
+		buses.reserve(config.buses_count);
+		for (size_t bus = 0; bus < config.buses_count; ++bus) {
+			const bool is_roundtrip = random.NextDouble() < 0.5;
+			std::vector<size_t> route{ random.NextIndex(stops_count) };
+			const size_t stops_per_bus = std::max<size_t>(config.stops_per_bus, 2);
+			while (route.size() < stops_per_bus) {
+				const size_t current = route.back();
+				std::vector<size_t> candidates;
+				if (current % grid_side > 0) {
+					candidates.push_back(current - 1);
+				}
+				if (current % grid_side + 1 < grid_side && current + 1 < stops_count) {
+					candidates.push_back(current + 1);
+				}
+				if (current >= grid_side) {
+					candidates.push_back(current - grid_side);
+				}
+				if (current + grid_side < stops_count) {
+					candidates.push_back(current + grid_side);
+				}
+				if (route.size() > 1 && candidates.size() > 1) {
+					candidates.erase(std::remove(candidates.begin(), candidates.end(), route[route.size() - 2]), candidates.end());
+				}
+				route.push_back(candidates[random.NextIndex(candidates.size())]);
+			}
+			if (is_roundtrip) {
+				route.push_back(route.front());
+			}
+
+			json::Array stops;
+			for (size_t i = 0; i < route.size(); ++i) {
+				stops.emplace_back(StopName(route[i]));
+				if (i > 0 && route[i - 1] != route[i]) {
+					road_neighbours[std::min(route[i - 1], route[i])].insert(std::max(route[i - 1], route[i]));
+				}
+			}
+			buses.emplace_back(json::Dict{ {"type"s, "Bus"s}, {"name"s, BusName(bus)},
+			                               {"stops"s, std::move(stops)}, {"is_roundtrip"s, is_roundtrip} });
+		}
+
+		json::Array base_requests;
+		base_requests.reserve(stops_count + buses.size());
+		for (size_t i = 0; i < stops_count; ++i) {
+			json::Dict road_distances;
+			for (size_t neighbour : road_neighbours[i]) {
+				// Дорога длиннее прямой на 10-60%
+				const double distance = geo::ComputeDistance(coordinates[i], coordinates[neighbour]) * (1.1 + 0.5 * random.NextDouble());
+				road_distances.emplace(StopName(neighbour), static_cast<int>(std::ceil(distance)));
+			}
+			base_requests.emplace_back(json::Dict{ {"type"s, "Stop"s}, {"name"s, StopName(i)},
+			                                       {"latitude"s, coordinates[i].lat}, {"longitude"s, coordinates[i].lng},
+			                                       {"road_distances"s, std::move(road_distances)} });
+		}
+		for (auto& bus : buses) {
+			base_requests.push_back(std::move(bus));
+		}
+
+		json::Array stat_requests;
+		stat_requests.reserve(config.stat_requests_count);
+		for (size_t id = 0; id < config.stat_requests_count; ++id) {
+			const double kind = random.NextDouble();
+			if (kind < config.map_requests_share) {
+				stat_requests.emplace_back(json::Dict{ {"id"s, static_cast<int>(id)}, {"type"s, "Map"s} });
+			}
+			else if (kind < config.map_requests_share + (1.0 - config.map_requests_share) / 2 && config.buses_count > 0) {
+				stat_requests.emplace_back(json::Dict{ {"id"s, static_cast<int>(id)}, {"type"s, "Bus"s},
+				                                       {"name"s, BusName(random.NextIndex(config.buses_count))} });
+			}
+			else {
+				stat_requests.emplace_back(json::Dict{ {"id"s, static_cast<int>(id)}, {"type"s, "Stop"s},
+				                                       {"name"s, StopName(random.NextIndex(stops_count))} });
+			}
+		}
+
+		return json::Document{ json::Dict{ {"base_requests"s, std::move(base_requests)},
+		                                   {"render_settings"s, CreateRenderSettings()},
+		                                   {"stat_requests"s, std::move(stat_requests)} } };
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../json.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace city_generator {
+
+	struct CityConfig {
+		size_t stops_count = 1000;
+		size_t buses_count = 100;
+		size_t stops_per_bus = 20;
+		size_t stat_requests_count = 1000;
+		// Доля запросов Map среди stat_requests; остальные делятся поровну между Bus и Stop
+		double map_requests_share = 0.001;
+		uint64_t seed = 42;
+	};
+
+	// Строит входной документ с base_requests, render_settings и stat_requests.
+	// Остановки расставлены по решётке с шагом около 300 м, маршруты - случайные блуждания по соседним узлам.
+	// Результат зависит только от config: генератор не использует распределения стандартной библиотеки,
+	// результат которых может отличаться между реализациями
+	json::Document GenerateCity(const CityConfig& config);
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "catalogue_store.h"
+
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace catalogue_store {
+
+	using namespace std::literals;
+
+	size_t CatalogueUpdate::GetChangesCount() const {
+		return upsert_stops.size() + upsert_buses.size() + upsert_distances.size()
+			+ remove_stops.size() + remove_buses.size() + remove_distances.size();
+	}
+
+	CatalogueStore::CatalogueStore(transport_catalogue::TransportCatalogue catalogue)
+		:snapshot_(std::make_shared<const Snapshot>(Snapshot{ 1, std::move(catalogue) }))
+	{
+	}
+
+	std::shared_ptr<const Snapshot> CatalogueStore::GetSnapshot() const {
+		return std::atomic_load(&snapshot_);
+	}
+
+	uint64_t CatalogueStore::Apply(const CatalogueUpdate& update) {
+		std::lock_guard guard(update_mutex_);
+		const std::shared_ptr<const Snapshot> current = GetSnapshot();
+		const transport_catalogue::TransportCatalogue& previous = current->catalogue;
+		auto next = std::make_shared<Snapshot>();
+		next->version = current->version + 1;
+		transport_catalogue::TransportCatalogue& catalogue = next->catalogue;
+
+		// Удаления применяются раньше добавлений: удалённое и снова добавленное название
+		// попадает в конец справочника с новыми данными. При повторах в одном наборе действует последний
+		const std::unordered_set<std::string_view> removed_stops(update.remove_stops.begin(), update.remove_stops.end());
+		const std::unordered_set<std::string_view> removed_buses(update.remove_buses.begin(), update.remove_buses.end());
+		const std::set<std::pair<std::string_view, std::string_view>> removed_distances(update.remove_distances.begin(),
+		                                                                                update.remove_distances.end());
+		std::unordered_map<std::string_view, const StopUpdate*> upserted_stops;
+		for (const StopUpdate& stop_update : update.upsert_stops) {
+			upserted_stops[stop_update.name] = &stop_update;
+		}
+		std::unordered_map<std::string_view, const BusUpdate*> upserted_buses;
+		for (const BusUpdate& bus_update : update.upsert_buses) {
+			upserted_buses[bus_update.name] = &bus_update;
+		}
+
+		// Остановки и маршруты сохраняют прежний порядок, а с ним и номера
+		for (const domain::Stop& stop : previous.GetStopsList()) {
+			if (removed_stops.count(stop.stop_name) > 0) {
+				continue;
+			}
+			const auto position = upserted_stops.find(stop.stop_name);
+			catalogue.AddStop(stop.stop_name,
+			                  position != upserted_stops.end() ? position->second->coordinates : stop.stop_coordinates);
+		}
+		for (const StopUpdate& stop_update : update.upsert_stops) {
+			if (catalogue.FindStop(stop_update.name) == nullptr) {
+				catalogue.AddStop(stop_update.name, upserted_stops.at(stop_update.name)->coordinates);
+			}
+		}
+
+		auto add_bus = [&catalogue](const std::string& bus_name, const auto& stops_names, bool is_roundtrip) {
+			std::vector<std::string_view> bus_stops;
+			bus_stops.reserve(stops_names.size());
+			for (const auto& stop_name : stops_names) {
+				if (catalogue.FindStop(stop_name) == nullptr) {
+					throw std::invalid_argument("Bus "s + bus_name + " passes through unknown stop "s + std::string(stop_name));
+				}
+				bus_stops.push_back(stop_name);
+			}
+			catalogue.AddBus(bus_name, bus_stops, is_roundtrip);
+		};
+		for (const domain::Bus& bus : previous.GetBusesList()) {
+			if (removed_buses.count(bus.bus_name) > 0) {
+				continue;
+			}
+			if (const auto position = upserted_buses.find(bus.bus_name); position != upserted_buses.end()) {
+				add_bus(bus.bus_name, position->second->stops, position->second->is_roundtrip);
+				continue;
+			}
+			std::vector<std::string_view> stops_names;
+			stops_names.reserve(bus.bus_stops.size());
+			for (const domain::Stop* stop : bus.bus_stops) {
+				stops_names.push_back(stop->stop_name);
+			}
+			add_bus(bus.bus_name, stops_names, bus.is_roundtrip);
+		}
+		for (const BusUpdate& bus_update : update.upsert_buses) {
+			if (catalogue.FindBus(bus_update.name) == nullptr) {
+				const BusUpdate& last_update = *upserted_buses.at(bus_update.name);
+				add_bus(last_update.name, last_update.stops, last_update.is_roundtrip);
+			}
+		}
+
+		for (const auto& [stops, distance] : previous.GetDistances()) {
+			if (stops.first == nullptr || stops.second == nullptr) {
+				continue;
+			}
+			const domain::Stop* from_stop = catalogue.FindStop(stops.first->stop_name);
+			const domain::Stop* to_stop = catalogue.FindStop(stops.second->stop_name);
+			if (from_stop == nullptr || to_stop == nullptr
+			    || removed_distances.count({ stops.first->stop_name, stops.second->stop_name }) > 0) {
+				continue;
+			}
+			catalogue.SetDistanceBetweenStops(from_stop, to_stop, distance);
+		}
+		auto set_distance = [&catalogue](std::string_view from_name, std::string_view to_name, int distance) {
+			const domain::Stop* from_stop = catalogue.FindStop(from_name);
+			const domain::Stop* to_stop = catalogue.FindStop(to_name);
+			if (from_stop == nullptr || to_stop == nullptr) {
+				throw std::invalid_argument("Distance between unknown stops "s + std::string(from_name)
+				                            + " and "s + std::string(to_name));
+			}
+			catalogue.SetDistanceBetweenStops(from_stop, to_stop, distance);
+		};
+		for (const StopUpdate& stop_update : update.upsert_stops) {
+			for (const auto& [to_name, distance] : stop_update.road_distances) {
+				set_distance(stop_update.name, to_name, distance);
+			}
+		}
+		for (const DistanceUpdate& distance_update : update.upsert_distances) {
+			set_distance(distance_update.from_stop, distance_update.to_stop, distance_update.distance);
+		}
+
+		// Заменённая остановка считается сдвинутой, даже если координаты те же: удалённая и снова
+		// добавленная остановка получает новый номер, и маршруты через неё пересчитываются целиком.
+		// Расстояния выше переносятся по названиям, так что прежние расстояния такой остановки сохраняются,
+		// если их не удалили в remove_requests
+		transport_catalogue::CatalogueChanges changes;
+		for (const StopUpdate& stop_update : update.upsert_stops) {
+			const domain::Stop* previous_stop = previous.FindStop(stop_update.name);
+			if (previous_stop != nullptr && (removed_stops.count(stop_update.name) > 0
+			    || previous_stop->stop_coordinates.lat != stop_update.coordinates.lat
+			    || previous_stop->stop_coordinates.lng != stop_update.coordinates.lng)) {
+				changes.moved_stops.insert(stop_update.name);
+			}
+			for (const auto& [to_name, distance] : stop_update.road_distances) {
+				changes.changed_distances.emplace_back(stop_update.name, to_name);
+			}
+		}
+		for (const DistanceUpdate& distance_update : update.upsert_distances) {
+			changes.changed_distances.emplace_back(distance_update.from_stop, distance_update.to_stop);
+		}
+		changes.changed_distances.insert(changes.changed_distances.end(), removed_distances.begin(), removed_distances.end());
+		for (const auto& [bus_name, bus_update] : upserted_buses) {
+			changes.changed_buses.insert(bus_name);
+		}
+		for (const std::string& stop_name : update.remove_stops) {
+			changes.are_stops_removed = changes.are_stops_removed || previous.FindStop(stop_name) != nullptr;
+		}
+
+		catalogue.SetDistanceModel(previous.GetDistanceModel());
+		catalogue.BuildIndexes(previous, changes);
+		try {
+			catalogue.CheckRouteLengths(previous);
+		}
+		catch (const std::out_of_range& error) {
+			throw std::invalid_argument(error.what());
+		}
+
+		std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(next)));
+		return current->version + 1;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace catalogue_store {
+
+	struct StopUpdate {
+		std::string name;
+		geo::Coordinates coordinates;
+		// Расстояния от этой остановки до соседних; остальные расстояния остановки сохраняются
+		std::vector<std::pair<std::string, int>> road_distances;
+	};
+
+	struct BusUpdate {
+		std::string name;
+		std::vector<std::string> stops;
+		bool is_roundtrip = false;
+	};
+
+	struct DistanceUpdate {
+		std::string from_stop;
+		std::string to_stop;
+		int distance = 0;
+	};
+
+	// Набор изменений, который применяется к справочнику целиком или не применяется вовсе.
+	// Добавление заменяет существующую остановку, маршрут или расстояние с тем же названием
+	struct CatalogueUpdate {
+		std::vector<StopUpdate> upsert_stops;
+		std::vector<BusUpdate> upsert_buses;
+		std::vector<DistanceUpdate> upsert_distances;
+		std::vector<std::string> remove_stops;
+		std::vector<std::string> remove_buses;
+		std::vector<std::pair<std::string, std::string>> remove_distances;
+
+		size_t GetChangesCount() const;
+	};
+
+	// Неизменяемая версия справочника с построенными индексами
+	struct Snapshot {
+		uint64_t version = 0;
+		transport_catalogue::TransportCatalogue catalogue;
+	};
+
+	// Хранилище версий справочника в духе RCU: читатели берут текущую версию без блокировок
+	// и работают с ней сколько угодно, а изменение строит новую версию рядом и публикует её
+	// атомарной заменой указателя. Старая версия освобождается, когда её отпустит последний читатель
+	class CatalogueStore {
+	public:
+		explicit CatalogueStore(transport_catalogue::TransportCatalogue catalogue);
+
+		std::shared_ptr<const Snapshot> GetSnapshot() const;
+
+		// Строит справочник из текущей версии и изменений, перестраивает индексы и публикует его
+		// как следующую версию; возвращает её номер. Изменения применяются по одному писателю за раз.
+		// Если изменения нарушают целостность справочника (маршрут через отсутствующую остановку,
+		// удаление остановки, через которую проходит маршрут, нет расстояния между соседними остановками
+		// маршрута, у которого прежде его хватало), бросает исключение с описанием нарушения,
+		// и текущая версия остаётся прежней
+		uint64_t Apply(const CatalogueUpdate& update);
+
+	private:
+		std::mutex update_mutex_;
+		// Читается и заменяется только через std::atomic_load и std::atomic_store
+		std::shared_ptr<const Snapshot> snapshot_;
+	};
+}
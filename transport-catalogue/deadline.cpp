@@ -0,0 +1,24 @@
+#include "deadline.h"
+
+namespace deadline {
+
+	DeadlineExceeded::DeadlineExceeded()
+		:std::runtime_error("deadline exceeded")
+	{
+	}
+
+	Deadline::Deadline(Clock::time_point time_point)
+		:time_point_(time_point)
+	{
+	}
+
+	bool Deadline::IsExpired() const {
+		return time_point_ && Clock::now() >= *time_point_;
+	}
+
+	void Deadline::Check() const {
+		if (IsExpired()) {
+			throw DeadlineExceeded();
+		}
+	}
+}
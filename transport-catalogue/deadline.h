@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+
+namespace deadline {
+
+	// Исключение, которым долгая работа прерывается, когда срок запроса истёк
+	class DeadlineExceeded : public std::runtime_error {
+	public:
+		DeadlineExceeded();
+	};
+
+	// Срок, к которому нужен ответ на запрос. Долгие циклы (отрисовка карты и т. п.) время от времени
+	// вызывают Check и прекращают работу, результат которой уже никому не нужен.
+	// Срок по умолчанию не ограничен, и Check ничего не стоит
+	class Deadline {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		Deadline() = default;
+
+		explicit Deadline(Clock::time_point time_point);
+
+		bool IsExpired() const;
+
+		// Бросает DeadlineExceeded, если срок истёк
+		void Check() const;
+
+	private:
+		std::optional<Clock::time_point> time_point_;
+	};
+}
@@ -3,6 +3,7 @@
 #include "geo.h"
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace domain {
@@ -10,12 +11,14 @@ namespace domain {
 	struct Stop {
 		std::string stop_name;
 		geo::Coordinates stop_coordinates;
+		size_t stop_id = 0;
 	};
 
 	struct Bus {
 		std::string bus_name;
 		std::vector<const Stop*> bus_stops;
 		bool is_roundtrip;
+		size_t bus_id = 0;
 	};
 
 	struct Bus_Information {
@@ -27,5 +30,16 @@ namespace domain {
 		double curvature;
 	};
 
+	struct Route_Segment_Information {
+		int route_length;
+		double geografical_route_length;
+		int span_count;
+	};
+
+	struct Transfers_Information {
+		std::vector<std::string_view> direct_buses;
+		std::vector<std::string_view> transfer_stops;
+	};
+
 
 }
\ No newline at end of file
@@ -1,16 +1,203 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
 
+// Ветка AVX2 собирается всегда, когда компилятор умеет атрибут target, а выбирается при запуске по процессору,
+// поэтому обычная сборка без -mavx2 тоже её использует
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
 namespace geo {
 
+namespace {
+
+const double DEGREES_TO_RADIANS = M_PI / 180.0;
+
+// Синусы и косинусы широт и долгот точек, разложенные по отдельным массивам
+struct TrigonometricTerms {
+    explicit TrigonometricTerms(size_t count)
+        : sin_lat(count), cos_lat(count), sin_lng(count), cos_lng(count) {
+    }
+
+    std::vector<double> sin_lat;
+    std::vector<double> cos_lat;
+    std::vector<double> sin_lng;
+    std::vector<double> cos_lng;
+};
+
+TrigonometricTerms CollectTrigonometricTerms(const PreparedCoordinates* points, size_t count) {
+    TrigonometricTerms terms(count);
+    for (size_t i = 0; i < count; ++i) {
+        terms.sin_lat[i] = points[i].sin_lat;
+        terms.cos_lat[i] = points[i].cos_lat;
+        terms.sin_lng[i] = points[i].sin_lng;
+        terms.cos_lng[i] = points[i].cos_lng;
+    }
+    return terms;
+}
+
+TrigonometricTerms ComputeTrigonometricTerms(const Coordinates* points, size_t count) {
+    std::vector<PreparedCoordinates> prepared_points(count);
+    for (size_t i = 0; i < count; ++i) {
+        prepared_points[i] = PrepareCoordinates(points[i]);
+    }
+    return CollectTrigonometricTerms(prepared_points.data(), count);
+}
+
+// Указатели на синусы и косинусы точек начиная с некоторой
+struct TermsView {
+    TermsView(const TrigonometricTerms& terms, size_t offset)
+        : sin_lat(terms.sin_lat.data() + offset), cos_lat(terms.cos_lat.data() + offset)
+        , sin_lng(terms.sin_lng.data() + offset), cos_lng(terms.cos_lng.data() + offset) {
+    }
+
+    const double* sin_lat;
+    const double* cos_lat;
+    const double* sin_lng;
+    const double* cos_lng;
+};
+
+// Косинусы центральных углов пар точек с номерами [begin, count)
+void ComputeAngleCosines(const TermsView& from, const TermsView& to, double* cosines, size_t begin, size_t count) {
+    for (size_t i = begin; i < count; ++i) {
+        const double cos_lng_difference = from.cos_lng[i] * to.cos_lng[i] + from.sin_lng[i] * to.sin_lng[i];
+        cosines[i] = from.sin_lat[i] * to.sin_lat[i] + from.cos_lat[i] * to.cos_lat[i] * cos_lng_difference;
+    }
+}
+
+#ifdef GEO_AVX2_DISPATCH
+// То же по четыре пары за раз; возвращает число обработанных пар, остаток досчитывает ComputeAngleCosines.
+// Векторизовано только это скалярное произведение: acos остаётся скалярным
+__attribute__((target("avx2")))
+size_t ComputeAngleCosinesAvx2(const TermsView& from, const TermsView& to, double* cosines, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d cos_lng_difference = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(from.cos_lng + i), _mm256_loadu_pd(to.cos_lng + i)),
+            _mm256_mul_pd(_mm256_loadu_pd(from.sin_lng + i), _mm256_loadu_pd(to.sin_lng + i)));
+        const __m256d cos_angle = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(from.sin_lat + i), _mm256_loadu_pd(to.sin_lat + i)),
+            _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(from.cos_lat + i), _mm256_loadu_pd(to.cos_lat + i)),
+                          cos_lng_difference));
+        _mm256_storeu_pd(cosines + i, cos_angle);
+    }
+    return i;
+}
+
+bool IsAvx2Supported() {
+    static const bool is_supported = __builtin_cpu_supports("avx2");
+    return is_supported;
+}
+#endif
+
+// Для пар точек (from + i, to + i) вычисляет расстояния по сферической теореме косинусов;
+// cos(lng1 - lng2) раскрывается через синусы и косинусы долгот, поэтому на пару остаётся один acos
+void ComputeDistancesFromTerms(const TrigonometricTerms& from_terms, size_t from_offset,
+                               const TrigonometricTerms& to_terms, size_t to_offset,
+                               double* distances, size_t count) {
+    const TermsView from(from_terms, from_offset);
+    const TermsView to(to_terms, to_offset);
+
+    size_t i = 0;
+#ifdef GEO_AVX2_DISPATCH
+    if (IsAvx2Supported()) {
+        i = ComputeAngleCosinesAvx2(from, to, distances, count);
+    }
+#endif
+    ComputeAngleCosines(from, to, distances, i, count);
+
+    // Из-за погрешности округления косинус совпадающих точек может оказаться чуть больше 1
+    for (i = 0; i < count; ++i) {
+        distances[i] = std::acos(std::clamp(distances[i], -1.0, 1.0)) * EARTH_RADIUS;
+    }
+}
+
+double ComputeHaversineDistance(const PreparedCoordinates& from, const PreparedCoordinates& to) {
+    const double sin_half_lat = std::sin((to.lat_rad - from.lat_rad) / 2);
+    const double sin_half_lng = std::sin((to.lng_rad - from.lng_rad) / 2);
+    const double haversine = sin_half_lat * sin_half_lat + from.cos_lat * to.cos_lat * sin_half_lng * sin_half_lng;
+    return 2 * std::asin(std::sqrt(std::min(haversine, 1.0))) * EARTH_RADIUS;
+}
+
+double ComputeEquirectangularDistance(const PreparedCoordinates& from, const PreparedCoordinates& to) {
+    // Косинус средней широты заменён средним косинусов: для коротких отрезков разница пренебрежимо мала
+    const double x = (to.lng_rad - from.lng_rad) * (from.cos_lat + to.cos_lat) / 2;
+    const double y = to.lat_rad - from.lat_rad;
+    return std::sqrt(x * x + y * y) * EARTH_RADIUS;
+}
+
+}  // namespace
+
 double ComputeDistance(Coordinates from, Coordinates to) {
     using namespace std;
     const double dr = M_PI / 180.0;
     return acos(sin(from.lat * dr) * sin(to.lat * dr)
                 + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-        * 6371000;
+        * EARTH_RADIUS;
+}
+
+PreparedCoordinates PrepareCoordinates(Coordinates point) {
+    PreparedCoordinates prepared_point;
+    prepared_point.lat_rad = point.lat * DEGREES_TO_RADIANS;
+    prepared_point.lng_rad = point.lng * DEGREES_TO_RADIANS;
+    prepared_point.sin_lat = std::sin(prepared_point.lat_rad);
+    prepared_point.cos_lat = std::cos(prepared_point.lat_rad);
+    prepared_point.sin_lng = std::sin(prepared_point.lng_rad);
+    prepared_point.cos_lng = std::cos(prepared_point.lng_rad);
+    return prepared_point;
+}
+
+double ComputeDistance(const PreparedCoordinates& from, const PreparedCoordinates& to, DistanceModel model) {
+    switch (model) {
+    case DistanceModel::HAVERSINE:
+        return ComputeHaversineDistance(from, to);
+    case DistanceModel::EQUIRECTANGULAR:
+        return ComputeEquirectangularDistance(from, to);
+    case DistanceModel::SPHERICAL_COSINES:
+    default: {
+        const double cos_lng_difference = from.cos_lng * to.cos_lng + from.sin_lng * to.sin_lng;
+        const double cos_angle = from.sin_lat * to.sin_lat + from.cos_lat * to.cos_lat * cos_lng_difference;
+        return std::acos(std::clamp(cos_angle, -1.0, 1.0)) * EARTH_RADIUS;
+    }
+    }
+}
+
+void ComputeDistances(const Coordinates* from, const Coordinates* to, double* distances, size_t count) {
+    const TrigonometricTerms from_terms = ComputeTrigonometricTerms(from, count);
+    const TrigonometricTerms to_terms = ComputeTrigonometricTerms(to, count);
+    ComputeDistancesFromTerms(from_terms, 0, to_terms, 0, distances, count);
+}
+
+std::vector<double> ComputeDistancesAlong(const std::vector<Coordinates>& points) {
+    if (points.size() < 2) {
+        return {};
+    }
+    // Каждая внутренняя точка ломаной входит в два отрезка, но её тригонометрия считается один раз
+    const TrigonometricTerms terms = ComputeTrigonometricTerms(points.data(), points.size());
+    std::vector<double> distances(points.size() - 1);
+    ComputeDistancesFromTerms(terms, 0, terms, 1, distances.data(), distances.size());
+    return distances;
+}
+
+std::vector<double> ComputeDistancesAlong(const std::vector<PreparedCoordinates>& points, DistanceModel model) {
+    if (points.size() < 2) {
+        return {};
+    }
+    std::vector<double> distances(points.size() - 1);
+    if (model == DistanceModel::SPHERICAL_COSINES) {
+        const TrigonometricTerms terms = CollectTrigonometricTerms(points.data(), points.size());
+        ComputeDistancesFromTerms(terms, 0, terms, 1, distances.data(), distances.size());
+    }
+    else {
+        for (size_t i = 0; i < distances.size(); ++i) {
+            distances[i] = ComputeDistance(points[i], points[i + 1], model);
+        }
+    }
+    return distances;
 }
 
 }  // namespace geo
\ No newline at end of file
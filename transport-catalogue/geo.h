@@ -1,12 +1,50 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 namespace geo {
 
+inline constexpr double EARTH_RADIUS = 6371000;
+
 struct Coordinates {
     double lat; // Широта
     double lng; // Долгота
 };
 
+// Величины, которые нужны для вычисления расстояний и не меняются, пока точка неподвижна
+struct PreparedCoordinates {
+    double lat_rad = 0.0; // Широта в радианах
+    double lng_rad = 0.0; // Долгота в радианах
+    double sin_lat = 0.0;
+    double cos_lat = 1.0;
+    double sin_lng = 0.0;
+    double cos_lng = 1.0;
+};
+
+// Модель вычисления расстояния между точками сферы
+enum class DistanceModel {
+    SPHERICAL_COSINES, // Сферическая теорема косинусов - модель ComputeDistance
+    HAVERSINE,         // Формула гаверсинусов: устойчива на коротких отрезках
+    EQUIRECTANGULAR    // Равнопромежуточная проекция: без тригонометрии, для отрезков до десятков километров
+};
+
 double ComputeDistance(Coordinates from, Coordinates to);
 
+PreparedCoordinates PrepareCoordinates(Coordinates point);
+
+double ComputeDistance(const PreparedCoordinates& from, const PreparedCoordinates& to,
+                       DistanceModel model = DistanceModel::SPHERICAL_COSINES);
+
+// Пакетный вариант ComputeDistance: distances[i] - расстояние от from[i] до to[i].
+// Синусы и косинусы вычисляются один раз на точку, а их произведения считаются по четыре пары за раз,
+// если процессор поддерживает AVX2; acos вычисляется для каждой пары отдельно
+void ComputeDistances(const Coordinates* from, const Coordinates* to, double* distances, size_t count);
+
+// Расстояния между соседними точками ломаной: i-й элемент - расстояние от points[i] до points[i + 1]
+std::vector<double> ComputeDistancesAlong(const std::vector<Coordinates>& points);
+
+std::vector<double> ComputeDistancesAlong(const std::vector<PreparedCoordinates>& points,
+                                          DistanceModel model = DistanceModel::SPHERICAL_COSINES);
+
 }  // namespace geo
\ No newline at end of file
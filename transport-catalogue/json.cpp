@@ -235,6 +235,8 @@ namespace json {
             std::ostream& out;
             int indent_step = 4;
             int indent = 0;
+            // Без переводов строк и отступов
+            bool compact = false;
 
             void PrintIndent() const {
                 for (int i = 0; i < indent; ++i) {
@@ -242,9 +244,15 @@ namespace json {
                 }
             }
 
+            void PrintLineBreak() const {
+                if (!compact) {
+                    out << std::endl;
+                }
+            }
+
             // Возвращает новый контекст вывода с увеличенным смещением
             PrintContext Indented() const {
-                return { out, indent_step, indent_step + indent };
+                return { out, indent_step, compact ? 0 : indent_step + indent, compact };
             }
         };
 
@@ -301,18 +309,20 @@ namespace json {
         void PrintValue(const Array& arr, const PrintContext& ctx) {
             std::ostream& out = ctx.out;
             bool first = true;
-            out << "["sv << std::endl;
+            out << "["sv;
+            ctx.PrintLineBreak();
             PrintContext map_ctx{ ctx.Indented() };
             map_ctx.PrintIndent();
             for (const auto& value : arr) {
                 if (!first) {
-                    map_ctx.out << ", "sv << std::endl;
+                    map_ctx.out << (ctx.compact ? ","sv : ", "sv);
+                    map_ctx.PrintLineBreak();
                     map_ctx.PrintIndent();
                 }
                 PrintNode(value, map_ctx);
                 first = false;
             }
-            out << std::endl;
+            ctx.PrintLineBreak();
             ctx.PrintIndent();
             out << "]"sv;
         }
@@ -320,20 +330,22 @@ namespace json {
         void PrintValue(const Dict& dict, const PrintContext& ctx) {
             std::ostream& out = ctx.out;
             bool first = true;
-            out << "{"sv << std::endl;
+            out << "{"sv;
+            ctx.PrintLineBreak();
             PrintContext map_ctx{ ctx.Indented() };
             map_ctx.PrintIndent();
             for (const auto& value : dict) {
                 if (!first) {
-                    map_ctx.out << ", "sv << std::endl;
+                    map_ctx.out << (ctx.compact ? ","sv : ", "sv);
+                    map_ctx.PrintLineBreak();
                     map_ctx.PrintIndent();
                 }
                 PrintValue(value.first, map_ctx);
-                map_ctx.out << ": "sv;
+                map_ctx.out << (ctx.compact ? ":"sv : ": "sv);
                 PrintNode(value.second, map_ctx);
                 first = false;
             }
-            out << std::endl;
+            ctx.PrintLineBreak();
             ctx.PrintIndent();
             out << "}"sv;
         }
@@ -346,6 +358,42 @@ namespace json {
                 node.GetValue());
         }
 
+
+        struct DocumentMemoryUsage {
+            size_t arrays_count = 0;
+            size_t arrays_bytes = 0;
+            size_t dicts_count = 0;
+            size_t dicts_bytes = 0;
+            size_t strings_count = 0;
+            size_t strings_bytes = 0;
+
+            void AddString(const std::string& value) {
+                ++strings_count;
+                strings_bytes += memory_usage::GetHeapBytes(value);
+            }
+
+            void AddNode(const Node& node) {
+                if (node.IsArray()) {
+                    ++arrays_count;
+                    arrays_bytes += memory_usage::GetHeapBytes(node.AsArray());
+                    for (const Node& element : node.AsArray()) {
+                        AddNode(element);
+                    }
+                }
+                else if (node.IsMap()) {
+                    ++dicts_count;
+                    dicts_bytes += memory_usage::GetHeapBytes(node.AsMap());
+                    for (const auto& [key, value] : node.AsMap()) {
+                        AddString(key);
+                        AddNode(value);
+                    }
+                }
+                else if (node.IsString()) {
+                    AddString(node.AsString());
+                }
+            }
+        };
+
     }  // namespace
 
     Node::Node(Value value)
@@ -430,6 +478,16 @@ namespace json {
         return root_;
     }
 
+    memory_usage::Report Document::MemoryUsage() const {
+        DocumentMemoryUsage usage;
+        usage.AddNode(root_);
+        memory_usage::Report report;
+        report.Add("arrays"s, usage.arrays_count, usage.arrays_bytes);
+        report.Add("dicts"s, usage.dicts_count, usage.dicts_bytes);
+        report.Add("strings"s, usage.strings_count, usage.strings_bytes);
+        return report;
+    }
+
     Document Load(std::istream& input) {
         return Document{ LoadNode(input) };
     }
@@ -438,6 +496,10 @@ namespace json {
         PrintNode(doc.GetRoot(), PrintContext{ output });
     }
 
+    void PrintCompact(const Document& doc, std::ostream& output) {
+        PrintNode(doc.GetRoot(), PrintContext{ output, 0, 0, true });
+    }
+
     bool operator==(const Node& left, const Node& right) {
         return left.GetValue() == right.GetValue();
     }
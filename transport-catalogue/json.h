@@ -1,5 +1,7 @@
 #pragma once
 
+#include "memory_usage.h"
+
 #include <iostream>
 #include <map>
 #include <string>
@@ -53,12 +55,17 @@ namespace json {
 
         const Node& GetRoot() const;
 
+        // Оценка памяти дерева документа: хранилища массивов, узлы словарей с ключами и тексты строк
+        memory_usage::Report MemoryUsage() const;
+
     private:
         Node root_;
     };
 
     Document Load(std::istream& input);
     void Print(const Document& doc, std::ostream& output);
+    // Печатает документ в одну строку, без переводов строк и отступов
+    void PrintCompact(const Document& doc, std::ostream& output);
     bool operator==(const Node& left, const Node& right);
     bool operator!=(const Node& left, const Node& right);
     bool operator==(const Document& left, const Document& right);
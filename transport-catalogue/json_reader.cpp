@@ -1,12 +1,43 @@
 #include "json_reader.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <optional>
 #include <stdexcept>
 #include <sstream>
 
 namespace json_reader {
 	using namespace std::literals;
 
+	Document JsonReader::LoadInput(std::istream& input, profiler::Profiler* profiler) {
+		profiler::Profiler::Phase phase(profiler, "parse"sv);
+		Document document = json::Load(input);
+		size_t requests_count = 0;
+		if (document.GetRoot().IsMap()) {
+			for (const auto& key : { "base_requests"s, "stat_requests"s }) {
+				if (auto position = document.GetRoot().AsMap().find(key);
+				    position != document.GetRoot().AsMap().end() && position->second.IsArray()) {
+					requests_count += position->second.AsArray().size();
+				}
+			}
+		}
+		phase.SetItems(requests_count);
+		return document;
+	}
+
+	memory_usage::Report JsonReader::MemoryUsage() const {
+		return input_json_.MemoryUsage();
+	}
+
+	bool JsonReader::HasBaseRequests() const {
+		return input_json_.GetRoot().AsMap().count("base_requests"s) > 0;
+	}
+
 	void JsonReader::AddStopsToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue) const {
+		profiler::Profiler::Phase phase(profiler_, "ingest"sv, "stops"sv, 0);
+		size_t added_count = 0;
 		std::string base_requests = "base_requests"s;
 		if (input_json_.GetRoot().AsMap().count(base_requests) > 0) {
 			auto& input_data = input_json_.GetRoot().AsMap().at(base_requests).AsArray();
@@ -16,6 +47,7 @@ namespace json_reader {
 					if (data.at("type"s).AsString() == "Stop"s) {
 						catalogue.AddStop(data.at("name"s).AsString(),
 							{ data.at("latitude"s).AsDouble(), data.at("longitude"s).AsDouble() });
+						++added_count;
 					}
 				}
 				else {
@@ -23,9 +55,12 @@ namespace json_reader {
 				}
 			}
 		} 
+		phase.SetItems(added_count);
 	}
 
 	void JsonReader::AddBusesToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue) const {
+		profiler::Profiler::Phase phase(profiler_, "ingest"sv, "buses"sv, 0);
+		size_t added_count = 0;
 		std::string base_requests = "base_requests"s;
 		if (input_json_.GetRoot().AsMap().count(base_requests) > 0) {
 			auto& input_data = input_json_.GetRoot().AsMap().at(base_requests).AsArray();
@@ -38,6 +73,7 @@ namespace json_reader {
 							stops.push_back(stop.AsString());
 						}
 						catalogue.AddBus(data.at("name"s).AsString(), stops, data.at("is_roundtrip"s).AsBool());
+						++added_count;
 					}
 				}
 				else {
@@ -45,10 +81,13 @@ namespace json_reader {
 				}
 			}
 		}
+		phase.SetItems(added_count);
 	}
 
 	void JsonReader::AddDistancesBetweenStopsToTransportCatalogue(
 		transport_catalogue::TransportCatalogue& catalogue) const {
+		profiler::Profiler::Phase phase(profiler_, "ingest"sv, "distances"sv, 0);
+		size_t added_count = 0;
 		std::string base_requests = "base_requests"s;
 		if (input_json_.GetRoot().AsMap().count(base_requests) > 0) {
 			auto& input_data = input_json_.GetRoot().AsMap().at(base_requests).AsArray();
@@ -61,6 +100,7 @@ namespace json_reader {
 						for (auto& [stop, distance] : road_distances) {
 							distances_container.emplace_back(distance.AsInt(), stop);
 						}
+						added_count += distances_container.size();
 						catalogue.AddDistanceBetweenStops(data.at("name"s).AsString(), distances_container);
 					}
 				}
@@ -69,6 +109,72 @@ namespace json_reader {
 				}
 			}
 		}
+		phase.SetItems(added_count);
+	}
+
+	void JsonReader::AddBaseRequestsToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue,
+	                                                     size_t threads_count) const {
+		struct Records {
+			std::vector<transport_catalogue::StopRecord> stops;
+			std::vector<transport_catalogue::BusRecord> buses;
+			std::vector<transport_catalogue::DistanceRecord> distances;
+		};
+		Records records;
+		{
+			static const Array empty_requests;
+			const auto position = input_json_.GetRoot().AsMap().find("base_requests"s);
+			const Array& input_data = position != input_json_.GetRoot().AsMap().end()
+				? position->second.AsArray() : empty_requests;
+			profiler::Profiler::Phase phase(profiler_, "ingest"sv, "records"sv, input_data.size());
+			std::vector<Records> chunks_records(std::max<size_t>(threads_count, 1));
+			parallel::ForEachChunk(input_data.size(), threads_count, [&](size_t chunk_index, size_t begin, size_t end) {
+				Records& chunk_records = chunks_records[chunk_index];
+				for (size_t i = begin; i < end; ++i) {
+					auto& data = input_data[i].AsMap();
+					const auto type = data.find("type"s);
+					if (type == data.end()) {
+						throw std::invalid_argument(std::string{ "Unknown request type" });
+					}
+					if (type->second.AsString() == "Stop"s) {
+						const std::string& name = data.at("name"s).AsString();
+						chunk_records.stops.push_back({ name, { data.at("latitude"s).AsDouble(),
+						                                        data.at("longitude"s).AsDouble() } });
+						if (const auto road_distances = data.find("road_distances"s); road_distances != data.end()) {
+							for (auto& [stop, distance] : road_distances->second.AsMap()) {
+								chunk_records.distances.push_back({ name, stop, distance.AsInt() });
+							}
+						}
+					}
+					else if (type->second.AsString() == "Bus"s) {
+						transport_catalogue::BusRecord& bus = chunk_records.buses.emplace_back();
+						bus.name = data.at("name"s).AsString();
+						for (auto& stop : data.at("stops"s).AsArray()) {
+							bus.stops.push_back(stop.AsString());
+						}
+						bus.is_roundtrip = data.at("is_roundtrip"s).AsBool();
+					}
+				}
+			});
+
+			// Части склеиваются по порядку, поэтому записи идут в порядке base_requests
+			for (Records& chunk_records : chunks_records) {
+				records.stops.insert(records.stops.end(), chunk_records.stops.begin(), chunk_records.stops.end());
+				std::move(chunk_records.buses.begin(), chunk_records.buses.end(), std::back_inserter(records.buses));
+				records.distances.insert(records.distances.end(), chunk_records.distances.begin(),
+				                         chunk_records.distances.end());
+			}
+		}
+
+		{
+			profiler::Profiler::Phase phase(profiler_, "ingest"sv, "stops"sv, records.stops.size());
+			catalogue.AddStops(records.stops, threads_count);
+		}
+		{
+			profiler::Profiler::Phase phase(profiler_, "ingest"sv, "buses"sv, records.buses.size());
+			catalogue.AddBuses(records.buses, threads_count);
+		}
+		profiler::Profiler::Phase phase(profiler_, "ingest"sv, "distances"sv, records.distances.size());
+		catalogue.AddDistances(records.distances, threads_count);
 	}
 
 	svg::Color ConvertColorToRgbOrRgbaFormat(std::vector<Node> color_array) {
@@ -89,6 +195,7 @@ namespace json_reader {
 	}
 
 	map_renderer::RenderSettings JsonReader::AddRenderingSettings() {
+		profiler::Profiler::Phase phase(profiler_, "render_settings"sv);
 		map_renderer::RenderSettings output_settings;
 		std::string render_settings = "render_settings"s;
 		if (input_json_.GetRoot().AsMap().count(render_settings) > 0) {
@@ -139,6 +246,49 @@ namespace json_reader {
 		return output_settings;
 	}
 
+	serialization::SerializationSettings JsonReader::AddSerializationSettings() const {
+		serialization::SerializationSettings output_settings;
+		std::string serialization_settings = "serialization_settings"s;
+		if (input_json_.GetRoot().AsMap().count(serialization_settings) > 0) {
+			auto& data = input_json_.GetRoot().AsMap().at(serialization_settings).AsMap();
+			output_settings.file = data.at("file"s).AsString();
+			if (data.count("format"s) > 0) {
+				const std::string& format = data.at("format"s).AsString();
+				if (format == "binary"s) {
+					output_settings.format = serialization::BaseFormat::BINARY;
+				}
+				else if (format == "mapped"s) {
+					output_settings.format = serialization::BaseFormat::MAPPED;
+				}
+				else {
+					throw std::invalid_argument(std::string{ "Unknown base format" });
+				}
+			}
+		}
+		else {
+			throw std::invalid_argument(std::string{ "There are not serialization settings" });
+		}
+		return output_settings;
+	}
+
+	geo::DistanceModel JsonReader::AddDistanceModel() const {
+		std::string distance_settings = "distance_settings"s;
+		if (input_json_.GetRoot().AsMap().count(distance_settings) == 0) {
+			return geo::DistanceModel::SPHERICAL_COSINES;
+		}
+		const std::string& model = input_json_.GetRoot().AsMap().at(distance_settings).AsMap().at("model"s).AsString();
+		if (model == "spherical_cosines"s) {
+			return geo::DistanceModel::SPHERICAL_COSINES;
+		}
+		else if (model == "haversine"s) {
+			return geo::DistanceModel::HAVERSINE;
+		}
+		else if (model == "equirectangular"s) {
+			return geo::DistanceModel::EQUIRECTANGULAR;
+		}
+		throw std::invalid_argument(std::string{ "Unknown distance model" });
+	}
+
 	Node CreateStopNode(const Dict& data, const transport_catalogue::TransportCatalogue& catalogue) {
 		Builder stop_node;
 		int request_id = data.at("id"s).AsInt();
@@ -186,17 +336,230 @@ namespace json_reader {
 		}
 	}
 
-	Node CreateMapNode(const Dict& data, const request_handler::RequestHandler& request_handler) {
+	Node CreateRouteDistanceNode(const Dict& data, const transport_catalogue::TransportCatalogue& catalogue) {
+		Builder distance_node;
+		int request_id = data.at("id"s).AsInt();
+		const domain::Bus* bus_iterator = catalogue.FindBus(data.at("bus"s).AsString());
+		const domain::Stop* from_stop = catalogue.FindStop(data.at("from"s).AsString());
+		const domain::Stop* to_stop = catalogue.FindStop(data.at("to"s).AsString());
+		std::optional<domain::Route_Segment_Information> segment_information;
+		if (bus_iterator != nullptr && from_stop != nullptr && to_stop != nullptr) {
+			segment_information = catalogue.GetDistanceAlongBus(bus_iterator, from_stop, to_stop);
+		}
+		if (!segment_information) {
+			distance_node.StartDict().Key("request_id"s).Value(request_id).
+				                      Key("error_message"s).Value("not found"s).EndDict();
+			return distance_node.Build();
+		}
+
+		distance_node.StartDict().Key("request_id"s).Value(request_id).
+			                      Key("route_length"s).Value(segment_information->route_length).
+			                      Key("span_count"s).Value(segment_information->span_count).EndDict();
+		return distance_node.Build();
+	}
+
+	Node CreateBusesNearbyNode(const Dict& data, const transport_catalogue::TransportCatalogue& catalogue) {
+		Builder buses_nearby_node;
+		int request_id = data.at("id"s).AsInt();
+		geo::Coordinates point = { data.at("latitude"s).AsDouble(), data.at("longitude"s).AsDouble() };
+		const double radius = data.at("radius"s).AsDouble();
+		if (!std::isfinite(point.lat) || !std::isfinite(point.lng)) {
+			throw std::invalid_argument(std::string{ "Coordinates must be finite numbers" });
+		}
+		if (!std::isfinite(radius) || radius < 0.0) {
+			throw std::invalid_argument(std::string{ "Radius must be a finite non-negative number" });
+		}
+		Array buses;
+		for (auto& bus : catalogue.GetBusesNearPoint(point, radius)) {
+			buses.emplace_back(std::string{ bus });
+		}
+		buses_nearby_node.StartDict().Key("buses"s).Value(buses).
+			                          Key("request_id"s).Value(request_id).EndDict();
+		return buses_nearby_node.Build();
+	}
+
+	Node CreateSearchNode(const Dict& data, const transport_catalogue::TransportCatalogue& catalogue) {
+		Builder search_node;
+		int request_id = data.at("id"s).AsInt();
+		int max_errors = data.count("max_errors"s) ? data.at("max_errors"s).AsInt() : 0;
+		bool is_prefix = data.count("prefix"s) ? data.at("prefix"s).AsBool() : true;
+		int limit = data.count("limit"s) ? data.at("limit"s).AsInt() : 10;
+		auto search_results = catalogue.SearchNames(data.at("query"s).AsString(), max_errors, is_prefix,
+			                                        static_cast<size_t>(std::max(limit, 0)));
+		Array items;
+		for (auto& search_result : search_results) {
+			items.emplace_back(Dict{ {"distance"s, search_result.distance},
+				                     {"name"s, std::string{ search_result.name }},
+				                     {"type"s, search_result.kind == search_index::NameKind::STOP ? "Stop"s : "Bus"s} });
+		}
+		search_node.StartDict().Key("items"s).Value(items).
+			                    Key("request_id"s).Value(request_id).EndDict();
+		return search_node.Build();
+	}
+
+	Node CreateTransfersNode(const Dict& data, const transport_catalogue::TransportCatalogue& catalogue) {
+		Builder transfers_node;
+		int request_id = data.at("id"s).AsInt();
+		const domain::Stop* from_stop = catalogue.FindStop(data.at("from"s).AsString());
+		const domain::Stop* to_stop = catalogue.FindStop(data.at("to"s).AsString());
+		if (from_stop == nullptr || to_stop == nullptr) {
+			transfers_node.StartDict().Key("request_id"s).Value(request_id).
+				                       Key("error_message"s).Value("not found"s).EndDict();
+			return transfers_node.Build();
+		}
+
+		auto transfers_information = catalogue.GetTransfersBetweenStops(from_stop, to_stop);
+		Array direct_buses;
+		for (auto& bus : transfers_information.direct_buses) {
+			direct_buses.emplace_back(std::string{ bus });
+		}
+		Array transfer_stops;
+		for (auto& stop : transfers_information.transfer_stops) {
+			transfer_stops.emplace_back(std::string{ stop });
+		}
+		transfers_node.StartDict().Key("direct_buses"s).Value(direct_buses).
+			                       Key("request_id"s).Value(request_id).
+			                       Key("transfer_stops"s).Value(transfer_stops).EndDict();
+		return transfers_node.Build();
+	}
+
+	Node CreateMapNode(const Dict& data, const request_handler::RequestHandler& request_handler,
+	                   const deadline::Deadline& deadline) {
 		Builder map_node;
 		int request_id = data.at("id"s).AsInt();
 		std::ostringstream out;
-		request_handler.RenderMap().Render(out);
+		request_handler.RenderMap(deadline).Render(out);
 		Node dict_node{ Dict{{"map"s, out.str()}, {"request_id", request_id}} };
 		map_node.StartDict().Key("map"s).Value(out.str()).
 			                 Key("request_id"s).Value(request_id).EndDict();
 		return map_node.Build();
 	}
 
+	// Возвращает ответ на запрос или std::nullopt для запроса неизвестного типа
+	std::optional<Node> CreateStatisticsNode(const Dict& data,
+		                                     const request_handler::RequestHandler& request_handler,
+		                                     const transport_catalogue::TransportCatalogue& catalogue,
+		                                     const deadline::Deadline& deadline) {
+		deadline.Check();
+		const std::string& type = data.at("type"s).AsString();
+		if (type == "Stop"s) {
+			return CreateStopNode(data, catalogue);
+		}
+		else if (type == "Bus"s) {
+			return CreateBusNode(data, catalogue);
+		}
+		else if (type == "Map"s) {
+			return CreateMapNode(data, request_handler, deadline);
+		}
+		else if (type == "RouteDistance"s) {
+			return CreateRouteDistanceNode(data, catalogue);
+		}
+		else if (type == "BusesNearby"s) {
+			return CreateBusesNearbyNode(data, catalogue);
+		}
+		else if (type == "Search"s) {
+			return CreateSearchNode(data, catalogue);
+		}
+		else if (type == "Transfers"s) {
+			return CreateTransfersNode(data, catalogue);
+		}
+		return std::nullopt;
+	}
+
+	catalogue_store::CatalogueUpdate ParseCatalogueUpdate(const Dict& data) {
+		catalogue_store::CatalogueUpdate update;
+		if (data.count("base_requests"s) > 0) {
+			for (auto& request : data.at("base_requests"s).AsArray()) {
+				auto& request_data = request.AsMap();
+				const std::string& type = request_data.at("type"s).AsString();
+				if (type == "Stop"s) {
+					catalogue_store::StopUpdate stop_update{ request_data.at("name"s).AsString(),
+						{ request_data.at("latitude"s).AsDouble(), request_data.at("longitude"s).AsDouble() }, {} };
+					if (request_data.count("road_distances"s) > 0) {
+						for (auto& [stop, distance] : request_data.at("road_distances"s).AsMap()) {
+							stop_update.road_distances.emplace_back(stop, distance.AsInt());
+						}
+					}
+					update.upsert_stops.push_back(std::move(stop_update));
+				}
+				else if (type == "Bus"s) {
+					catalogue_store::BusUpdate bus_update{ request_data.at("name"s).AsString(), {},
+						                                   request_data.at("is_roundtrip"s).AsBool() };
+					for (auto& stop : request_data.at("stops"s).AsArray()) {
+						bus_update.stops.push_back(stop.AsString());
+					}
+					update.upsert_buses.push_back(std::move(bus_update));
+				}
+				else if (type == "Distance"s) {
+					update.upsert_distances.push_back({ request_data.at("from"s).AsString(),
+						                                request_data.at("to"s).AsString(),
+						                                request_data.at("distance"s).AsInt() });
+				}
+				else {
+					throw std::invalid_argument(std::string{ "Unknown request type" });
+				}
+			}
+		}
+		if (data.count("remove_requests"s) > 0) {
+			for (auto& request : data.at("remove_requests"s).AsArray()) {
+				auto& request_data = request.AsMap();
+				const std::string& type = request_data.at("type"s).AsString();
+				if (type == "Stop"s) {
+					update.remove_stops.push_back(request_data.at("name"s).AsString());
+				}
+				else if (type == "Bus"s) {
+					update.remove_buses.push_back(request_data.at("name"s).AsString());
+				}
+				else if (type == "Distance"s) {
+					update.remove_distances.emplace_back(request_data.at("from"s).AsString(),
+					                                     request_data.at("to"s).AsString());
+				}
+				else {
+					throw std::invalid_argument(std::string{ "Unknown request type" });
+				}
+			}
+		}
+		return update;
+	}
+
+	Node CreateMappedStopNode(const Dict& data, const mapped_catalogue::MappedCatalogue& catalogue) {
+		Builder stop_node;
+		int request_id = data.at("id"s).AsInt();
+		auto stop_id = catalogue.FindStop(data.at("name"s).AsString());
+		if (!stop_id) {
+			stop_node.StartDict().Key("request_id"s).Value(request_id).
+				                  Key("error_message"s).Value("not found"s).EndDict();
+			return stop_node.Build();
+		}
+
+		Array buses;
+		for (auto& bus : catalogue.GetBusesForStop(*stop_id)) {
+			buses.emplace_back(std::string{ bus });
+		}
+		stop_node.StartDict().Key("buses"s).Value(buses).
+			                  Key("request_id"s).Value(request_id).EndDict();
+		return stop_node.Build();
+	}
+
+	Node CreateMappedBusNode(const Dict& data, const mapped_catalogue::MappedCatalogue& catalogue) {
+		Builder bus_node;
+		int request_id = data.at("id"s).AsInt();
+		auto bus_id = catalogue.FindBus(data.at("name"s).AsString());
+		if (!bus_id) {
+			bus_node.StartDict().Key("request_id"s).Value(request_id).
+				                 Key("error_message"s).Value("not found"s).EndDict();
+			return bus_node.Build();
+		}
+
+		auto bus_information = catalogue.GetBusInformation(*bus_id);
+		bus_node.StartDict().Key("curvature"s).Value(bus_information.curvature).
+			                 Key("request_id"s).Value(request_id).
+			                 Key("route_length"s).Value(bus_information.bus_route_length).
+			                 Key("stop_count"s).Value(bus_information.stops_on_bus_route).
+			                 Key("unique_stop_count"s).Value(bus_information.unique_bus_stops).EndDict();
+		return bus_node.Build();
+	}
+
 	void JsonReader::PrintStatistics(const request_handler::RequestHandler& request_handler,
 		                             const transport_catalogue::TransportCatalogue& catalogue,
 		                             std::ostream& output) {
@@ -208,23 +571,59 @@ namespace json_reader {
 			for (auto& input_data_elemant : input_data) {
 				auto& data = input_data_elemant.AsMap();
 				if (data.count("type"s)) {
+					auto phase = profiler::Profiler::Phase::ForRequest(profiler_, data.at("type"s).AsString());
+					if (auto statistics = CreateStatisticsNode(data, request_handler, catalogue)) {
+						output_statistics.Value(statistics->GetValue());
+					}
+				}
+				else {
+					throw std::invalid_argument(std::string{ "Unknown request type" });
+				}
+			}
+			profiler::Profiler::Phase phase(profiler_, "print"sv, {}, input_data.size());
+			json::Print(Document{ output_statistics.EndArray().Build() }, output);
+		}
+	}
+
+	void JsonReader::PrintStatistics(const mapped_catalogue::MappedCatalogue& catalogue,
+		                             const map_renderer::MapRender& map_renderer,
+		                             std::ostream& output) {
+		std::string stat_requests = "stat_requests"s;
+		// Развёрнутый справочник строится только при первом запросе, которому нужны его индексы
+		std::optional<transport_catalogue::TransportCatalogue> materialized_catalogue;
+		std::optional<request_handler::RequestHandler> request_handler;
+		Builder output_statistics;
+		output_statistics.StartArray();
+		if (input_json_.GetRoot().AsMap().count(stat_requests) > 0) {
+			auto& input_data = input_json_.GetRoot().AsMap().at(stat_requests).AsArray();
+			for (auto& input_data_elemant : input_data) {
+				auto& data = input_data_elemant.AsMap();
+				if (data.count("type"s)) {
+					auto phase = profiler::Profiler::Phase::ForRequest(profiler_, data.at("type"s).AsString());
 					if (data.at("type"s).AsString() == "Stop"s) {
-						Node stop = CreateStopNode(data, catalogue);
-						output_statistics.Value(stop.GetValue());						
+						Node stop = CreateMappedStopNode(data, catalogue);
+						output_statistics.Value(stop.GetValue());
+						continue;
 					}
 					else if (data.at("type"s).AsString() == "Bus"s) {
-						Node bus = CreateBusNode(data, catalogue);
+						Node bus = CreateMappedBusNode(data, catalogue);
 						output_statistics.Value(bus.GetValue());
+						continue;
+					}
+					if (!materialized_catalogue) {
+						profiler::Profiler::Phase materialize_phase(profiler_, "materialize"sv);
+						catalogue.Materialize(materialized_catalogue.emplace());
+						request_handler.emplace(*materialized_catalogue, map_renderer);
 					}
-					else if (data.at("type"s).AsString() == "Map"s) {
-						Node map = CreateMapNode(data, request_handler);
-						output_statistics.Value(map.GetValue());
+					if (auto statistics = CreateStatisticsNode(data, *request_handler, *materialized_catalogue)) {
+						output_statistics.Value(statistics->GetValue());
 					}
 				}
 				else {
 					throw std::invalid_argument(std::string{ "Unknown request type" });
 				}
 			}
+			profiler::Profiler::Phase phase(profiler_, "print"sv, {}, input_data.size());
 			json::Print(Document{ output_statistics.EndArray().Build() }, output);
 		}
 	}
@@ -1,37 +1,82 @@
 #pragma once
 
+#include "catalogue_store.h"
+#include "deadline.h"
 #include "json.h"
 #include "json_builder.h"
 #include "transport_catalogue.h"
 #include "request_handler.h"
 #include "map_renderer.h"
+#include "mapped_catalogue.h"
+#include "serialization.h"
+#include "profiler.h"
 
+#include <optional>
 #include<vector>
 
 namespace json_reader {
 	
 	using namespace json;
 
+	// Ответ на один запрос из stat_requests или std::nullopt для неизвестного типа запроса.
+	// Долгие запросы проверяют deadline и по его истечении бросают deadline::DeadlineExceeded
+	std::optional<Node> CreateStatisticsNode(const Dict& data,
+	                                         const request_handler::RequestHandler& request_handler,
+	                                         const transport_catalogue::TransportCatalogue& catalogue,
+	                                         const deadline::Deadline& deadline = {});
+
+	// Изменения справочника из запроса Update: base_requests в формате базы (Stop, Bus и Distance
+	// с полями from, to и distance) и remove_requests с type и name или from и to для Distance
+	catalogue_store::CatalogueUpdate ParseCatalogueUpdate(const Dict& data);
+
 	class JsonReader {
 	public:
-		JsonReader(std::istream& input)
-			: input_json_(json::Load(input))
+		// При ненулевом profiler время разбора, загрузки справочника и ответов на запросы
+		// записывается в него по фазам
+		JsonReader(std::istream& input, profiler::Profiler* profiler = nullptr)
+			: input_json_(LoadInput(input, profiler)), profiler_(profiler)
 		{
 		}
 
+		// Есть ли во входном документе base_requests, по которым можно построить справочник
+		bool HasBaseRequests() const;
+
 		void AddStopsToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue) const;
 
 		void AddBusesToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue) const;
 		
 		void AddDistancesBetweenStopsToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue) const;
+
+		// Загружает остановки, маршруты и расстояния из base_requests так же, как три метода выше подряд,
+		// но в threads_count потоков: base_requests делятся на непрерывные части, каждый поток собирает
+		// записи своей части, а справочник добавляет их пакетами (TransportCatalogue::AddStops и др.)
+		void AddBaseRequestsToTransportCatalogue(transport_catalogue::TransportCatalogue& catalogue,
+		                                         size_t threads_count) const;
 		
 		map_renderer::RenderSettings AddRenderingSettings();
+
+		serialization::SerializationSettings AddSerializationSettings() const;
+
+		// Оценка памяти, которую занимает разобранный входной документ
+		memory_usage::Report MemoryUsage() const;
+
+		// Модель географических расстояний из distance_settings; по умолчанию - сферическая теорема косинусов
+		geo::DistanceModel AddDistanceModel() const;
 		
 		void PrintStatistics(const request_handler::RequestHandler& request_handler,
 			                 const transport_catalogue::TransportCatalogue& catalogue,
 			                 std::ostream& output);
 
+		// Отвечает на Bus и Stop прямо из образа справочника; остальные запросы обслуживает
+		// справочник, развёрнутый из образа при первом таком запросе
+		void PrintStatistics(const mapped_catalogue::MappedCatalogue& catalogue,
+			                 const map_renderer::MapRender& map_renderer,
+			                 std::ostream& output);
+
 	private:
 		Document input_json_;
+		profiler::Profiler* profiler_;
+
+		static Document LoadInput(std::istream& input, profiler::Profiler* profiler);
 	};
 }
\ No newline at end of file
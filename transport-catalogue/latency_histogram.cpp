@@ -0,0 +1,93 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace profiler {
+
+	namespace {
+		constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << LatencyHistogram::SUB_BUCKET_BITS;
+		constexpr uint64_t SUB_BUCKET_HALF_COUNT = SUB_BUCKET_COUNT / 2;
+		// Значения до SUB_BUCKET_COUNT лежат в линейных корзинах, каждая следующая степень двойки
+		// добавляет SUB_BUCKET_HALF_COUNT корзин
+		constexpr size_t BUCKETS_COUNT = SUB_BUCKET_COUNT + (64 - LatencyHistogram::SUB_BUCKET_BITS) * SUB_BUCKET_HALF_COUNT;
+
+		int GetMostSignificantBit(uint64_t value) {
+			int bit = 0;
+			for (int step = 32; step > 0; step /= 2) {
+				if (value >> step) {
+					value >>= step;
+					bit += step;
+				}
+			}
+			return bit;
+		}
+	}
+
+	LatencyHistogram::LatencyHistogram()
+		:counts_(BUCKETS_COUNT, 0)
+	{
+	}
+
+	size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+		if (value < SUB_BUCKET_COUNT) {
+			return static_cast<size_t>(value);
+		}
+		const int shift = GetMostSignificantBit(value) - SUB_BUCKET_BITS + 1;
+		return static_cast<size_t>(shift * SUB_BUCKET_HALF_COUNT + (value >> shift));
+	}
+
+	uint64_t LatencyHistogram::GetBucketHighestValue(size_t index) {
+		if (index < SUB_BUCKET_COUNT) {
+			return index;
+		}
+		const size_t shift = index / SUB_BUCKET_HALF_COUNT - 1;
+		const uint64_t sub_bucket = index - shift * SUB_BUCKET_HALF_COUNT;
+		return ((sub_bucket + 1) << shift) - 1;
+	}
+
+	void LatencyHistogram::Record(uint64_t nanoseconds) {
+		++counts_[GetBucketIndex(nanoseconds)];
+		++total_count_;
+		max_ = std::max(max_, nanoseconds);
+		sum_ += nanoseconds;
+	}
+
+	void LatencyHistogram::Merge(const LatencyHistogram& other) {
+		for (size_t i = 0; i < counts_.size(); ++i) {
+			counts_[i] += other.counts_[i];
+		}
+		total_count_ += other.total_count_;
+		max_ = std::max(max_, other.max_);
+		sum_ += other.sum_;
+	}
+
+	uint64_t LatencyHistogram::GetCount() const {
+		return total_count_;
+	}
+
+	uint64_t LatencyHistogram::GetMax() const {
+		return max_;
+	}
+
+	double LatencyHistogram::GetMean() const {
+		return total_count_ > 0 ? static_cast<double>(sum_ / total_count_) : 0.0;
+	}
+
+	uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const {
+		if (total_count_ == 0) {
+			return 0;
+		}
+		const double clamped_percentile = std::clamp(percentile, 0.0, 100.0);
+		const uint64_t target_count = std::max<uint64_t>(
+			static_cast<uint64_t>(std::ceil(clamped_percentile / 100.0 * static_cast<double>(total_count_))), 1);
+		uint64_t accumulated_count = 0;
+		for (size_t i = 0; i < counts_.size(); ++i) {
+			accumulated_count += counts_[i];
+			if (accumulated_count >= target_count) {
+				return std::min(GetBucketHighestValue(i), max_);
+			}
+		}
+		return max_;
+	}
+}
\ No newline at end of file
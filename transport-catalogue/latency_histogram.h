@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace profiler {
+
+	// Гистограмма задержек в наносекундах с логарифмически-линейными корзинами, как в HdrHistogram:
+	// значения до 2^SUB_BUCKET_BITS хранятся точно, дальше каждая степень двойки делится на
+	// 2^(SUB_BUCKET_BITS - 1) корзин, так что относительная погрешность не превышает 1/64
+	class LatencyHistogram {
+	public:
+		static constexpr int SUB_BUCKET_BITS = 7;
+
+		LatencyHistogram();
+
+		void Record(uint64_t nanoseconds);
+
+		void Merge(const LatencyHistogram& other);
+
+		uint64_t GetCount() const;
+		uint64_t GetMax() const;
+		double GetMean() const;
+
+		// Наибольшее значение корзины, в которую попадает заданная доля замеров (percentile от 0 до 100)
+		uint64_t GetValueAtPercentile(double percentile) const;
+
+	private:
+		std::vector<uint64_t> counts_;
+		uint64_t total_count_ = 0;
+		uint64_t max_ = 0;
+		long double sum_ = 0;
+
+		static size_t GetBucketIndex(uint64_t value);
+		static uint64_t GetBucketHighestValue(size_t index);
+	};
+}
\ No newline at end of file
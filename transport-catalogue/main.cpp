@@ -1,24 +1,385 @@
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
 #include <string>
-#include <iostream>
+#include <string_view>
+
+#include <csignal>
+#include <unistd.h>
 
+#include "async_input.h"
+#include "catalogue_store.h"
 #include "request_handler.h"
 #include "json_reader.h"
 #include "map_renderer.h"
+#include "mapped_catalogue.h"
+#include "serialization.h"
+#include "profiler.h"
+#include "query_server.h"
+#include "request_pipeline.h"
+#include "shared_memory_server.h"
+#include "socket_server.h"
 
 using namespace std;
 
-int main() {
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: transport_catalogue [make_base|process_requests|serve [--pipeline [--workers=N]]] [--ingest-threads=N] [--async-input] [--profile[=report.json]] [--trace=trace.json] [--perf-counters]\n"sv
+           << "       transport_catalogue listen --socket=path [--workers=N] [--heavy-workers=N] [profiling options]\n"sv
+           << "       transport_catalogue listen --shm=name [profiling options]\n"sv
+           << "       transport_catalogue query --shm=name\n"sv;
+}
+
+struct CommandLine {
+    std::string_view mode;
+    // Отчёт по фазам печатается в stderr, а при заданном profile_file - в этот файл в формате JSON
+    bool profile = false;
+    std::string profile_file;
+    // Файл трассы в формате Chrome trace event
+    std::string trace_file;
+    // Аппаратные счётчики процессора по фазам в отчёте профилирования
+    bool perf_counters = false;
+    // Сокет и число рабочих потоков режима listen
+    std::string socket_path;
+    size_t workers_count = max(thread::hardware_concurrency(), 1u);
+    // Сколько из них могут одновременно отвечать на Map и Update; 0 - все, кроме одного
+    size_t heavy_workers_count = 0;
+    // Имя объекта общей памяти для режимов listen и query
+    std::string shm_name;
+    // Число потоков загрузки base_requests
+    size_t ingest_threads = 1;
+    // Чтение stdin в фоновом потоке с двойной буферизацией
+    bool async_input = false;
+    // Режим serve на конвейере сопрограмм request_pipeline
+    bool pipeline = false;
+};
+
+optional<CommandLine> ParseCommandLine(int argc, char* argv[]) {
+    CommandLine command_line;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument(argv[i]);
+        if (argument == "--profile"sv) {
+            command_line.profile = true;
+        }
+        else if (argument.substr(0, "--profile="sv.size()) == "--profile="sv) {
+            command_line.profile = true;
+            command_line.profile_file = std::string(argument.substr("--profile="sv.size()));
+        }
+        else if (argument == "--perf-counters"sv) {
+            command_line.profile = true;
+            command_line.perf_counters = true;
+        }
+        else if (argument.substr(0, "--socket="sv.size()) == "--socket="sv) {
+            command_line.socket_path = std::string(argument.substr("--socket="sv.size()));
+        }
+        else if (argument.substr(0, "--workers="sv.size()) == "--workers="sv) {
+            command_line.workers_count = stoul(std::string(argument.substr("--workers="sv.size())));
+        }
+        else if (argument.substr(0, "--ingest-threads="sv.size()) == "--ingest-threads="sv) {
+            command_line.ingest_threads = max<size_t>(stoul(std::string(argument.substr("--ingest-threads="sv.size()))), 1);
+        }
+        else if (argument == "--pipeline"sv) {
+            command_line.pipeline = true;
+        }
+        else if (argument == "--async-input"sv) {
+            command_line.async_input = true;
+        }
+        else if (argument.substr(0, "--heavy-workers="sv.size()) == "--heavy-workers="sv) {
+            command_line.heavy_workers_count = stoul(std::string(argument.substr("--heavy-workers="sv.size())));
+        }
+        else if (argument.substr(0, "--shm="sv.size()) == "--shm="sv) {
+            command_line.shm_name = std::string(argument.substr("--shm="sv.size()));
+        }
+        else if (argument.substr(0, "--trace="sv.size()) == "--trace="sv) {
+            command_line.trace_file = std::string(argument.substr("--trace="sv.size()));
+        }
+        else if (command_line.mode.empty() && argument.substr(0, 2) != "--"sv) {
+            command_line.mode = argument;
+        }
+        else {
+            return nullopt;
+        }
+    }
+    return command_line;
+}
+
+// Добавляет в отчёт память справочника и входного документа, пока оба живы
+void AddMemoryUsage(profiler::Profiler* profiler, const json_reader::JsonReader& input_request,
+                    const transport_catalogue::TransportCatalogue* catalogue) {
+    if (!profiler) {
+        return;
+    }
+    if (catalogue) {
+        profiler->AddMemoryUsage("transport catalogue"s, catalogue->MemoryUsage());
+    }
+    profiler->AddMemoryUsage("input json"s, input_request.MemoryUsage());
+}
+
+// Заполняет справочник по base_requests и строит его индексы
+void BuildCatalogue(const json_reader::JsonReader& input_request, transport_catalogue::TransportCatalogue& catalogue,
+                    size_t ingest_threads, profiler::Profiler* profiler) {
+    input_request.AddBaseRequestsToTransportCatalogue(catalogue, ingest_threads);
+    catalogue.SetDistanceModel(input_request.AddDistanceModel());
+    profiler::Profiler::Phase phase(profiler, "build_indexes"sv);
+    catalogue.BuildIndexes();
+}
+
+// Загружает справочник из двоичного файла serialization_settings для serve и listen.
+// Образ для отображения в память отвергается: эти режимы отвечают на все типы запросов и изменяют справочник,
+// а из отображённых таблиц отвечаются только Bus и Stop, так что образ пришлось бы разворачивать целиком,
+// и он был бы лишь медленной копией двоичной базы
+void LoadBase(const json_reader::JsonReader& input_request, transport_catalogue::TransportCatalogue& catalogue,
+              map_renderer::RenderSettings& render_settings, profiler::Profiler* profiler) {
+    const auto serialization_settings = input_request.AddSerializationSettings();
+    if (serialization_settings.format == serialization::BaseFormat::MAPPED) {
+        throw invalid_argument("serve and listen do not support \"format\": \"mapped\" bases; "s
+                               "use process_requests or a base made with \"format\": \"binary\""s);
+    }
+    catalogue.SetDistanceModel(input_request.AddDistanceModel());
+    profiler::Profiler::Phase phase(profiler, "deserialize"sv);
+    ifstream base_file(serialization_settings.file, ios::binary);
+    serialization::DeserializeBase(base_file, catalogue, render_settings);
+}
+
+// Строит справочник по base_requests и отвечает на stat_requests из одного JSON-документа
+void ProcessAll(istream& input, ostream& output, size_t ingest_threads, profiler::Profiler* profiler) {
     transport_catalogue::TransportCatalogue catalogue;
-    json_reader::JsonReader input_request(cin);
+    json_reader::JsonReader input_request(input, profiler);
 
-    input_request.AddStopsToTransportCatalogue(catalogue);
-    input_request.AddBusesToTransportCatalogue(catalogue);    
-    input_request.AddDistancesBetweenStopsToTransportCatalogue(catalogue);
+    BuildCatalogue(input_request, catalogue, ingest_threads, profiler);
+    AddMemoryUsage(profiler, input_request, &catalogue);
 
     map_renderer::MapRender map_renderer(input_request.AddRenderingSettings());
+    map_renderer.SetProfiler(profiler);
 
     request_handler::RequestHandler request_handler(catalogue, map_renderer);
 
-    input_request.PrintStatistics(request_handler, catalogue, cout);
- }
\ No newline at end of file
+    input_request.PrintStatistics(request_handler, catalogue, output);
+}
+
+// Строит справочник по base_requests и сохраняет его в файл из serialization_settings
+void MakeBase(istream& input, size_t ingest_threads, profiler::Profiler* profiler) {
+    transport_catalogue::TransportCatalogue catalogue;
+    json_reader::JsonReader input_request(input, profiler);
+
+    input_request.AddBaseRequestsToTransportCatalogue(catalogue, ingest_threads);
+
+    const auto serialization_settings = input_request.AddSerializationSettings();
+    ofstream base_file(serialization_settings.file, ios::binary);
+    if (serialization_settings.format == serialization::BaseFormat::MAPPED) {
+        catalogue.SetDistanceModel(input_request.AddDistanceModel());
+        {
+            profiler::Profiler::Phase phase(profiler, "build_indexes"sv);
+            catalogue.BuildIndexes();
+        }
+        AddMemoryUsage(profiler, input_request, &catalogue);
+        const auto render_settings = input_request.AddRenderingSettings();
+        profiler::Profiler::Phase phase(profiler, "serialize"sv);
+        mapped_catalogue::WriteMappedBase(catalogue, render_settings, base_file);
+    }
+    else {
+        AddMemoryUsage(profiler, input_request, &catalogue);
+        const auto render_settings = input_request.AddRenderingSettings();
+        profiler::Profiler::Phase phase(profiler, "serialize"sv);
+        serialization::SerializeBase(catalogue, render_settings, base_file);
+    }
+}
+
+// Загружает справочник из файла serialization_settings и отвечает на stat_requests
+void ProcessRequests(istream& input, ostream& output, profiler::Profiler* profiler) {
+    json_reader::JsonReader input_request(input, profiler);
+
+    const auto serialization_settings = input_request.AddSerializationSettings();
+    if (serialization_settings.format == serialization::BaseFormat::MAPPED) {
+        optional<profiler::Profiler::Phase> phase(in_place, profiler, "deserialize"sv);
+        const mapped_catalogue::MappedCatalogue catalogue(serialization_settings.file);
+        map_renderer::MapRender map_renderer(catalogue.GetRenderSettings());
+        map_renderer.SetProfiler(profiler);
+        phase.reset();
+        AddMemoryUsage(profiler, input_request, nullptr);
+        input_request.PrintStatistics(catalogue, map_renderer, output);
+        return;
+    }
+
+    transport_catalogue::TransportCatalogue catalogue;
+    map_renderer::RenderSettings render_settings;
+    LoadBase(input_request, catalogue, render_settings, profiler);
+    AddMemoryUsage(profiler, input_request, &catalogue);
+
+    map_renderer::MapRender map_renderer(render_settings);
+    map_renderer.SetProfiler(profiler);
+
+    request_handler::RequestHandler request_handler(catalogue, map_renderer);
+
+    input_request.PrintStatistics(request_handler, catalogue, output);
+}
+
+// Строит справочник по base_requests входного документа или загружает его из serialization_settings
+void PrepareCatalogue(istream& input, transport_catalogue::TransportCatalogue& catalogue,
+                      map_renderer::RenderSettings& render_settings, size_t ingest_threads,
+                      profiler::Profiler* profiler) {
+    json_reader::JsonReader input_request(input, profiler);
+    if (input_request.HasBaseRequests()) {
+        BuildCatalogue(input_request, catalogue, ingest_threads, profiler);
+        render_settings = input_request.AddRenderingSettings();
+    }
+    else {
+        LoadBase(input_request, catalogue, render_settings, profiler);
+    }
+    AddMemoryUsage(profiler, input_request, &catalogue);
+}
+
+// Готовит справочник по первому JSON-документу, затем отвечает на запросы,
+// которые приходят по одному JSON-объекту в строке
+void Serve(istream& input, ostream& output, const CommandLine& command_line, profiler::Profiler* profiler) {
+    transport_catalogue::TransportCatalogue catalogue;
+    map_renderer::RenderSettings render_settings;
+    PrepareCatalogue(input, catalogue, render_settings, command_line.ingest_threads, profiler);
+    catalogue_store::CatalogueStore store(move(catalogue));
+
+    map_renderer::MapRender map_renderer(render_settings);
+    map_renderer.SetProfiler(profiler);
+    map_renderer.EnableFragmentCache();
+
+#ifdef REQUEST_PIPELINE_AVAILABLE
+    if (command_line.pipeline) {
+        request_pipeline::PipelineSettings settings;
+        settings.workers_count = command_line.workers_count;
+        request_pipeline::ServeStream(input, output, store, map_renderer, settings, profiler);
+        return;
+    }
+#endif
+    query_server::ServeStream(input, output, store, map_renderer, profiler);
+}
+
+// Обслуживает клиентов сервера до SIGINT или SIGTERM
+template <typename Server>
+void RunUntilSignal(Server& server) {
+    static Server* running_server = nullptr;
+    running_server = &server;
+    struct sigaction action {};
+    action.sa_handler = [](int) {
+        if (running_server) {
+            running_server->Stop();
+        }
+    };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    server.Run();
+    running_server = nullptr;
+}
+
+// Готовит справочник по JSON-документу из input и обслуживает клиентов сокета или общей памяти до SIGINT или SIGTERM
+void Listen(istream& input, const CommandLine& command_line, profiler::Profiler* profiler) {
+    transport_catalogue::TransportCatalogue catalogue;
+    map_renderer::RenderSettings render_settings;
+    PrepareCatalogue(input, catalogue, render_settings, command_line.ingest_threads, profiler);
+    catalogue_store::CatalogueStore store(move(catalogue));
+
+    map_renderer::MapRender map_renderer(render_settings);
+    map_renderer.SetProfiler(profiler);
+    map_renderer.EnableFragmentCache();
+
+    if (!command_line.shm_name.empty()) {
+        shared_memory_server::ServerSettings settings;
+        settings.name = command_line.shm_name;
+        shared_memory_server::Server server(store, map_renderer, move(settings), profiler);
+        RunUntilSignal(server);
+        return;
+    }
+
+    socket_server::ServerSettings settings;
+    settings.socket_path = command_line.socket_path;
+    settings.workers_count = command_line.workers_count;
+    settings.heavy_workers_limit = command_line.heavy_workers_count;
+    socket_server::Server server(store, map_renderer, move(settings), profiler);
+    RunUntilSignal(server);
+}
+
+// Передаёт серверу на общей памяти запросы из input по одному в строке и печатает ответы
+void Query(istream& input, ostream& output, const CommandLine& command_line) {
+    shared_memory_server::Client client(command_line.shm_name);
+    string line;
+    while (getline(input, line)) {
+        if (line.find_first_not_of(" \t\r"sv) == string::npos) {
+            continue;
+        }
+        output << client.Call(line) << '\n';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const auto command_line = ParseCommandLine(argc, argv);
+    if (!command_line) {
+        PrintUsage();
+        return 1;
+    }
+#ifndef REQUEST_PIPELINE_AVAILABLE
+    if (command_line->pipeline) {
+        cerr << "serve --pipeline requires a build with C++20 coroutines\n"sv;
+        return 1;
+    }
+#endif
+
+    optional<profiler::Profiler> profiler;
+    if (command_line->profile || !command_line->trace_file.empty()) {
+        profiler.emplace(profiler::ProfilerSettings{ !command_line->trace_file.empty(), command_line->perf_counters });
+    }
+    profiler::Profiler* profiler_pointer = profiler ? &*profiler : nullptr;
+
+    // Разбор и ответы читают stdin через фоновый поток, если он включён; std::cin тогда не используется
+    optional<async_input::InputStream> async_input;
+    if (command_line->async_input) {
+        async_input.emplace(STDIN_FILENO);
+    }
+    istream& input = async_input ? *async_input : cin;
+
+    // Ошибки входных данных и базы печатаются одной строкой вместо аварийного завершения
+    try {
+        if (command_line->mode.empty()) {
+            ProcessAll(input, cout, command_line->ingest_threads, profiler_pointer);
+        }
+        else if (command_line->mode == "make_base"sv) {
+            MakeBase(input, command_line->ingest_threads, profiler_pointer);
+        }
+        else if (command_line->mode == "process_requests"sv) {
+            ProcessRequests(input, cout, profiler_pointer);
+        }
+        else if (command_line->mode == "listen"sv && (!command_line->socket_path.empty() || !command_line->shm_name.empty())) {
+            Listen(input, *command_line, profiler_pointer);
+        }
+        else if (command_line->mode == "query"sv && !command_line->shm_name.empty()) {
+            Query(input, cout, *command_line);
+        }
+        else if (command_line->mode == "serve"sv) {
+            // Ответы сбрасываются самим сервером, когда запросов во входном буфере не осталось
+            ios::sync_with_stdio(false);
+            cin.tie(nullptr);
+            Serve(input, cout, *command_line, profiler_pointer);
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    catch (const exception& error) {
+        cerr << "error: "sv << error.what() << '\n';
+        return 1;
+    }
+
+    if (!command_line->trace_file.empty()) {
+        ofstream trace_file(command_line->trace_file);
+        profiler->PrintTrace(trace_file);
+    }
+    if (command_line->profile) {
+        if (command_line->profile_file.empty()) {
+            profiler->PrintReport(cerr);
+        }
+        else {
+            ofstream report_file(command_line->profile_file);
+            profiler->PrintJsonReport(report_file);
+        }
+    }
+}
\ No newline at end of file
@@ -1,12 +1,56 @@
 #include "map_renderer.h"
 
+#include <sstream>
+
 bool IsZero(double value) {
     return std::abs(value) < EPSILON;
 }
 
 namespace map_renderer {
 
-    svg::Document MapRender::CreateMap(const std::map<std::string_view, const domain::Bus*>& buses, const std::map<std::string_view, const domain::Stop*>& stops) const {
+    using namespace std::literals;
+
+    void MapRender::SetProfiler(profiler::Profiler* profiler) {
+        profiler_ = profiler;
+    }
+
+    void MapRender::EnableFragmentCache() {
+        is_fragment_cache_enabled_ = true;
+    }
+
+    namespace {
+        // Тег, отрисованный заранее; фрагмент, которому принадлежит строка, живёт вместе с тегом
+        class RenderedTag : public svg::Object {
+        public:
+            RenderedTag(std::shared_ptr<const void> fragment, std::string_view tag)
+                : fragment_(std::move(fragment)), tag_(tag) {
+            }
+
+        private:
+            std::shared_ptr<const void> fragment_;
+            std::string_view tag_;
+
+            void RenderObject(const svg::RenderContext& context) const override {
+                context.out << tag_;
+            }
+        };
+
+        // Отрисовывает тег так же, как его вывел бы svg::Document, но без отступа и перевода строки
+        std::string RenderTag(const svg::Object& object) {
+            std::ostringstream out;
+            object.Render(svg::RenderContext{ out });
+            std::string tag = out.str();
+            tag.pop_back();
+            return tag;
+        }
+
+        bool IsSameCoordinates(geo::Coordinates lhs, geo::Coordinates rhs) {
+            return lhs.lat == rhs.lat && lhs.lng == rhs.lng;
+        }
+    }
+
+    svg::Document MapRender::CreateMap(const std::map<std::string_view, const domain::Bus*>& buses, const std::map<std::string_view, const domain::Stop*>& stops,
+                                       const deadline::Deadline& deadline) const {
         svg::Document output_map;
 
         std::deque<geo::Coordinates> stops_geo_coords;
@@ -19,114 +63,255 @@ namespace map_renderer {
         }
 
         // Создаём проектор сферических координат на карту
+        std::optional<profiler::Profiler::Phase> projector_phase(std::in_place, profiler_, "render"sv, "sphere_projector"sv,
+                                                                 stops_geo_coords.size());
         const SphereProjector sphere_projector{ stops_geo_coords.begin(),
                                                 stops_geo_coords.end(),
                                                 render_settings_.picture_size.x,
                                                 render_settings_.picture_size.y,
                                                 render_settings_.padding };
+        projector_phase.reset();
 
-        RenderBusesPolyline(output_map, buses, sphere_projector);
-        RenderBusesNames(output_map, buses, sphere_projector);
-        RenderStopsNames(output_map, stops, sphere_projector);
-               
-        return output_map;
-    }
+        if (!is_fragment_cache_enabled_) {
+            return CreateMapWithoutCache(buses, stops, sphere_projector, deadline);
+        }
 
-    void MapRender::RenderBusesPolyline(svg::Document& output_map,
-        const std::map<std::string_view, const domain::Bus*>& buses,
-        const SphereProjector& sphere_projector) const {
-        size_t color_counter = 0;
-        for (const auto& [bus_name, bus_detail] : buses) {
-            if (!bus_detail->bus_stops.empty()) {
-                svg::Polyline bus_svg;
-                for (const auto& stop : bus_detail->bus_stops) {
-                    bus_svg.AddPoint(sphere_projector(stop->stop_coordinates));
+        std::shared_ptr<const Fragments> previous_fragments;
+        {
+            std::lock_guard guard(fragments_mutex_);
+            previous_fragments = fragments_;
+        }
+        auto fragments = std::make_shared<Fragments>();
+        std::vector<std::shared_ptr<const BusFragment>> buses_fragments;
+        std::vector<std::shared_ptr<const StopFragment>> stops_fragments;
+        {
+            // Цвет маршрута - его номер по алфавиту среди непустых маршрутов, так что добавление
+            // или удаление маршрута перекрашивает и перерисовывает маршруты после него
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "fragments"sv, 0);
+            size_t rendered_count = 0;
+            size_t color_counter = 0;
+            for (const auto& [bus_name, bus_detail] : buses) {
+                if (bus_detail->bus_stops.empty()) {
+                    continue;
                 }
-                if (!bus_detail->is_roundtrip) {
-                    for (auto it = bus_detail->bus_stops.rbegin() + 1; it != bus_detail->bus_stops.rend(); it++) {
-                        bus_svg.AddPoint(sphere_projector((*it)->stop_coordinates));
+                deadline.Check();
+                std::shared_ptr<const BusFragment> fragment;
+                if (previous_fragments) {
+                    if (auto position = previous_fragments->buses.find(std::string(bus_name));
+                        position != previous_fragments->buses.end()) {
+                        fragment = position->second;
                     }
                 }
-                bus_svg.SetStrokeColor(render_settings_.color_palette[color_counter]);
+                if (!fragment || !(fragment->sphere_projector == sphere_projector) || fragment->color_index != color_counter
+                    || fragment->is_roundtrip != bus_detail->is_roundtrip
+                    || !std::equal(fragment->stops_coordinates.begin(), fragment->stops_coordinates.end(),
+                                   bus_detail->bus_stops.begin(), bus_detail->bus_stops.end(),
+                                   [](geo::Coordinates coordinates, const domain::Stop* stop) {
+                                       return IsSameCoordinates(coordinates, stop->stop_coordinates);
+                                   })) {
+                    fragment = RenderBusFragment(*bus_detail, color_counter, sphere_projector);
+                    ++rendered_count;
+                }
+                fragments->buses.emplace(bus_name, fragment);
+                buses_fragments.push_back(std::move(fragment));
                 ++color_counter;
                 if (color_counter == render_settings_.color_palette.size()) {
                     color_counter = 0;
                 }
-                bus_svg.SetFillColor(std::string{ "none" });
-                bus_svg.SetStrokeWidth(render_settings_.line_width);
-                bus_svg.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-                bus_svg.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-                output_map.Add(bus_svg);
             }
+            for (const auto& [stop_name, stop_detail] : stops) {
+                deadline.Check();
+                std::shared_ptr<const StopFragment> fragment;
+                if (previous_fragments) {
+                    if (auto position = previous_fragments->stops.find(std::string(stop_name));
+                        position != previous_fragments->stops.end()) {
+                        fragment = position->second;
+                    }
+                }
+                if (!fragment || !(fragment->sphere_projector == sphere_projector)
+                    || !IsSameCoordinates(fragment->stop_coordinates, stop_detail->stop_coordinates)) {
+                    fragment = RenderStopFragment(*stop_detail, sphere_projector);
+                    ++rendered_count;
+                }
+                fragments->stops.emplace(stop_name, fragment);
+                stops_fragments.push_back(std::move(fragment));
+            }
+            phase.SetItems(rendered_count);
+        }
+        {
+            std::lock_guard guard(fragments_mutex_);
+            fragments_ = std::move(fragments);
         }
-    }
 
-    void MapRender::RenderBusesNames(svg::Document& output_map,
-        const std::map<std::string_view, const domain::Bus*>& buses, const SphereProjector& sphere_projector) const {
-        size_t color_counter = 0;
-        for (const auto& [bus_name, bus_detail] : buses) {
-            if (!bus_detail->bus_stops.empty()) {
-                const domain::Stop* the_firs_stop = bus_detail->bus_stops.front();
-                svg::Point the_first_stop_coordinates = sphere_projector(the_firs_stop->stop_coordinates);
-
-                svg::Text the_first_stop_svg = RenderSvgBusText(bus_detail->bus_name,
-                    the_first_stop_coordinates,
-                    static_cast<int>(color_counter),
-                    false);
-
-                svg::Text the_first_stop_background_svg = RenderSvgBusText(bus_detail->bus_name,
-                    the_first_stop_coordinates,
-                    static_cast<int>(color_counter),
-                    true);
-
-                output_map.Add(the_first_stop_background_svg);
-                output_map.Add(the_first_stop_svg);
-
-                if (!bus_detail->is_roundtrip && bus_detail->bus_stops.front() != bus_detail->bus_stops.back()) {
-                    const domain::Stop* the_last_stop = bus_detail->bus_stops.back();
-                    svg::Point the_last_stop_coordinates = sphere_projector(the_last_stop->stop_coordinates);
-
-                    svg::Text the_last_stop_svg = RenderSvgBusText(bus_detail->bus_name,
-                        the_last_stop_coordinates,
-                        static_cast<int>(color_counter),
-                        false);
-
-                    svg::Text the_last_stop_background_svg = RenderSvgBusText(bus_detail->bus_name,
-                        the_last_stop_coordinates,
-                        static_cast<int>(color_counter),
-                        true);
-
-                    output_map.Add(the_last_stop_background_svg);
-                    output_map.Add(the_last_stop_svg);
+        //Выводим линии маршрутов
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "buses_polyline"sv, buses.size());
+            for (const auto& fragment : buses_fragments) {
+                output_map.Add(RenderedTag{ fragment, fragment->polyline });
+            }
+        }
+        //Выводим названия маршрутов
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "buses_names"sv, buses.size());
+            for (const auto& fragment : buses_fragments) {
+                for (const std::string& label : fragment->labels) {
+                    output_map.Add(RenderedTag{ fragment, label });
+                }
+            }
+        }
+        //Выводим остановки и их названия
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "stops_names"sv, stops.size());
+            for (const auto& fragment : stops_fragments) {
+                output_map.Add(RenderedTag{ fragment, fragment->circle });
+            }
+            for (const auto& fragment : stops_fragments) {
+                for (const std::string& label : fragment->labels) {
+                    output_map.Add(RenderedTag{ fragment, label });
                 }
+            }
+        }
+               
+        return output_map;
+    }
 
+    svg::Document MapRender::CreateMapWithoutCache(const std::map<std::string_view, const domain::Bus*>& buses,
+                                                   const std::map<std::string_view, const domain::Stop*>& stops,
+                                                   const SphereProjector& sphere_projector,
+                                                   const deadline::Deadline& deadline) const {
+        svg::Document output_map;
+
+        //Выводим линии маршрутов
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "buses_polyline"sv, buses.size());
+            size_t color_counter = 0;
+            for (const auto& [bus_name, bus_detail] : buses) {
+                if (bus_detail->bus_stops.empty()) {
+                    continue;
+                }
+                deadline.Check();
+                output_map.Add(RenderSvgBusPolyline(*bus_detail, color_counter, sphere_projector));
+                ++color_counter;
+                if (color_counter == render_settings_.color_palette.size()) {
+                    color_counter = 0;
+                }
+            }
+        }
+        //Выводим названия маршрутов
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "buses_names"sv, buses.size());
+            size_t color_counter = 0;
+            for (const auto& [bus_name, bus_detail] : buses) {
+                if (bus_detail->bus_stops.empty()) {
+                    continue;
+                }
+                for (svg::Text& label : RenderSvgBusLabels(*bus_detail, color_counter, sphere_projector)) {
+                    output_map.Add(std::move(label));
+                }
                 ++color_counter;
                 if (color_counter == render_settings_.color_palette.size()) {
                     color_counter = 0;
                 }
             }
         }
+        //Выводим остановки и их названия
+        deadline.Check();
+        {
+            profiler::Profiler::Phase phase(profiler_, "render"sv, "stops_names"sv, stops.size());
+            for (const auto& [stop_name, stop_detail] : stops) {
+                deadline.Check();
+                output_map.Add(RenderSvgStopCircle(*stop_detail, sphere_projector));
+            }
+            for (const auto& [stop_name, stop_detail] : stops) {
+                for (svg::Text& label : RenderSvgStopLabels(*stop_detail, sphere_projector)) {
+                    output_map.Add(std::move(label));
+                }
+            }
+        }
+
+        return output_map;
+    }
+
+    std::shared_ptr<const MapRender::BusFragment> MapRender::RenderBusFragment(const domain::Bus& bus, size_t color_index,
+        const SphereProjector& sphere_projector) const {
+        auto fragment = std::make_shared<BusFragment>(BusFragment{ sphere_projector, color_index, bus.is_roundtrip, {}, {}, {} });
+        fragment->stops_coordinates.reserve(bus.bus_stops.size());
+        for (const auto& stop : bus.bus_stops) {
+            fragment->stops_coordinates.push_back(stop->stop_coordinates);
+        }
+        fragment->polyline = RenderTag(RenderSvgBusPolyline(bus, color_index, sphere_projector));
+        for (const svg::Text& label : RenderSvgBusLabels(bus, color_index, sphere_projector)) {
+            fragment->labels.push_back(RenderTag(label));
+        }
+        return fragment;
     }
 
-    void MapRender::RenderStopsNames(svg::Document& output_map,
-        const std::map<std::string_view, const domain::Stop*>& stops, const SphereProjector& sphere_projector) const {
-        for (const auto& [stop_name, stop_detail] : stops) {
-            svg::Circle stop_circle_svg;
-            stop_circle_svg.SetCenter(sphere_projector(stop_detail->stop_coordinates));
-            stop_circle_svg.SetRadius(render_settings_.stop_radius);
-            stop_circle_svg.SetFillColor(std::string{ "white" });
-            output_map.Add(stop_circle_svg);
+    std::shared_ptr<const MapRender::StopFragment> MapRender::RenderStopFragment(const domain::Stop& stop,
+        const SphereProjector& sphere_projector) const {
+        auto fragment = std::make_shared<StopFragment>(StopFragment{ sphere_projector, stop.stop_coordinates, {}, {} });
+        fragment->circle = RenderTag(RenderSvgStopCircle(stop, sphere_projector));
+        for (const svg::Text& label : RenderSvgStopLabels(stop, sphere_projector)) {
+            fragment->labels.push_back(RenderTag(label));
         }
+        return fragment;
+    }
 
-        for (const auto& [stop_name, stop_detail] : stops) {
-            svg::Point stop_svg_coordinates = sphere_projector(stop_detail->stop_coordinates);
+    svg::Polyline MapRender::RenderSvgBusPolyline(const domain::Bus& bus, size_t color_index,
+        const SphereProjector& sphere_projector) const {
+        svg::Polyline bus_svg;
+        for (const auto& stop : bus.bus_stops) {
+            bus_svg.AddPoint(sphere_projector(stop->stop_coordinates));
+        }
+        if (!bus.is_roundtrip) {
+            for (auto it = bus.bus_stops.rbegin() + 1; it != bus.bus_stops.rend(); it++) {
+                bus_svg.AddPoint(sphere_projector((*it)->stop_coordinates));
+            }
+        }
+        bus_svg.SetStrokeColor(render_settings_.color_palette[color_index]);
+        bus_svg.SetFillColor(std::string{ "none" });
+        bus_svg.SetStrokeWidth(render_settings_.line_width);
+        bus_svg.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        bus_svg.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        return bus_svg;
+    }
 
-            svg::Text stop_svg = RenderSvgStopText(stop_detail->stop_name, stop_svg_coordinates, false);
-            svg::Text stop_svg_background = RenderSvgStopText(stop_detail->stop_name, stop_svg_coordinates, true);
+    std::vector<svg::Text> MapRender::RenderSvgBusLabels(const domain::Bus& bus, size_t color_index,
+        const SphereProjector& sphere_projector) const {
+        std::vector<svg::Text> labels;
+        const domain::Stop* the_firs_stop = bus.bus_stops.front();
+        svg::Point the_first_stop_coordinates = sphere_projector(the_firs_stop->stop_coordinates);
+        labels.push_back(RenderSvgBusText(bus.bus_name, the_first_stop_coordinates, static_cast<int>(color_index), true));
+        labels.push_back(RenderSvgBusText(bus.bus_name, the_first_stop_coordinates, static_cast<int>(color_index), false));
 
-            output_map.Add(stop_svg_background);
-            output_map.Add(stop_svg);
+        if (!bus.is_roundtrip && bus.bus_stops.front() != bus.bus_stops.back()) {
+            const domain::Stop* the_last_stop = bus.bus_stops.back();
+            svg::Point the_last_stop_coordinates = sphere_projector(the_last_stop->stop_coordinates);
+            labels.push_back(RenderSvgBusText(bus.bus_name, the_last_stop_coordinates, static_cast<int>(color_index), true));
+            labels.push_back(RenderSvgBusText(bus.bus_name, the_last_stop_coordinates, static_cast<int>(color_index), false));
         }
+        return labels;
+    }
+
+    svg::Circle MapRender::RenderSvgStopCircle(const domain::Stop& stop, const SphereProjector& sphere_projector) const {
+        svg::Circle stop_circle_svg;
+        stop_circle_svg.SetCenter(sphere_projector(stop.stop_coordinates));
+        stop_circle_svg.SetRadius(render_settings_.stop_radius);
+        stop_circle_svg.SetFillColor(std::string{ "white" });
+        return stop_circle_svg;
+    }
+
+    std::vector<svg::Text> MapRender::RenderSvgStopLabels(const domain::Stop& stop,
+        const SphereProjector& sphere_projector) const {
+        const svg::Point stop_svg_coordinates = sphere_projector(stop.stop_coordinates);
+        std::vector<svg::Text> labels;
+        labels.push_back(RenderSvgStopText(stop.stop_name, stop_svg_coordinates, true));
+        labels.push_back(RenderSvgStopText(stop.stop_name, stop_svg_coordinates, false));
+        return labels;
     }
 
     svg::Text MapRender::RenderSvgBusText(const std::string& text,
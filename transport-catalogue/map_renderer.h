@@ -1,16 +1,22 @@
 #pragma once
 
+#include "deadline.h"
 #include "domain.h"
 #include "svg.h"
 #include "domain.h"
 #include "geo.h"
+#include "profiler.h"
 
 #include <algorithm>
 #include <cstdlib>
 #include <deque>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 inline const double EPSILON = 1e-6;
@@ -78,6 +84,11 @@ public:
 		};
 	}
 
+	bool operator==(const SphereProjector& other) const {
+		return padding_ == other.padding_ && min_lon_ == other.min_lon_
+			&& max_lat_ == other.max_lat_ && zoom_coeff_ == other.zoom_coeff_;
+	}
+
 private:
 	double padding_;
 	double min_lon_ = 0;
@@ -123,22 +134,76 @@ namespace map_renderer {
 		{
 		}
 
-		svg::Document CreateMap(const std::map<std::string_view, const domain::Bus*>& buses, const std::map<std::string_view, const domain::Stop*>& stops) const;
+		// Перед каждым фрагментом и каждым слоем проверяет срок deadline и по его истечении бросает
+		// deadline::DeadlineExceeded; кэш фрагментов при этом остаётся от предыдущей карты
+		svg::Document CreateMap(const std::map<std::string_view, const domain::Bus*>& buses, const std::map<std::string_view, const domain::Stop*>& stops,
+		                        const deadline::Deadline& deadline = {}) const;
+
+		// Построение проектора и каждый слой карты замеряются как фазы render.*
+		void SetProfiler(profiler::Profiler* profiler);
+
+		// Включает кэш отрисованных фрагментов. Он окупается, когда карту просят снова по изменённому
+		// справочнику (CatalogueStore); без кэша карта выводится сразу в документ, без промежуточных строк
+		void EnableFragmentCache();
 
 	private:
+		// Отрисованные теги маршрута: линия и надписи у конечных. Вместе с тегами хранится всё,
+		// от чего они зависят, - фрагмент годится, пока не изменились проекция, цвет маршрута и его остановки
+		struct BusFragment {
+			SphereProjector sphere_projector;
+			size_t color_index = 0;
+			bool is_roundtrip = false;
+			std::vector<geo::Coordinates> stops_coordinates;
+			std::string polyline;
+			std::vector<std::string> labels;
+		};
+
+		// Отрисованные теги остановки: кружок и надпись, зависят от проекции и координат остановки
+		struct StopFragment {
+			SphereProjector sphere_projector;
+			geo::Coordinates stop_coordinates;
+			std::string circle;
+			std::vector<std::string> labels;
+		};
+
+		// Фрагменты последней отрисованной карты по названиям маршрутов и остановок
+		struct Fragments {
+			std::unordered_map<std::string, std::shared_ptr<const BusFragment>> buses;
+			std::unordered_map<std::string, std::shared_ptr<const StopFragment>> stops;
+		};
+
 		RenderSettings render_settings_;
+		profiler::Profiler* profiler_ = nullptr;
+
+		// Следующая карта перерисовывает только фрагменты, зависимости которых изменились:
+		// после изменения справочника это маршруты и остановки, которых коснулось изменение,
+		// если только не сдвинулись границы карты
+		bool is_fragment_cache_enabled_ = false;
+		mutable std::mutex fragments_mutex_;
+		mutable std::shared_ptr<const Fragments> fragments_;
+
+		svg::Document CreateMapWithoutCache(const std::map<std::string_view, const domain::Bus*>& buses,
+			const std::map<std::string_view, const domain::Stop*>& stops,
+			const SphereProjector& sphere_projector,
+			const deadline::Deadline& deadline) const;
+
+		std::shared_ptr<const BusFragment> RenderBusFragment(const domain::Bus& bus, size_t color_index,
+			const SphereProjector& sphere_projector) const;
+
+		std::shared_ptr<const StopFragment> RenderStopFragment(const domain::Stop& stop,
+			const SphereProjector& sphere_projector) const;
+
+		svg::Polyline RenderSvgBusPolyline(const domain::Bus& bus, size_t color_index,
+			const SphereProjector& sphere_projector) const;
 
-		//Выводим линии маршрутов
-		void RenderBusesPolyline(svg::Document& output_map,
-			const std::map<std::string_view, const domain::Bus*>& buses, const SphereProjector& sphere_projector) const;
+		// Надписи у конечных: подложка и текст у первой остановки, а у некольцевого маршрута и у последней
+		std::vector<svg::Text> RenderSvgBusLabels(const domain::Bus& bus, size_t color_index,
+			const SphereProjector& sphere_projector) const;
 
-		//Выводим названия маршрутов
-		void RenderBusesNames(svg::Document& output_map,
-			const std::map<std::string_view, const domain::Bus*>& buses, const SphereProjector& sphere_projector) const;
+		svg::Circle RenderSvgStopCircle(const domain::Stop& stop, const SphereProjector& sphere_projector) const;
 
-		//Выводим названия остановок
-		void RenderStopsNames(svg::Document& output_map,
-			const std::map<std::string_view, const domain::Stop*>& stops, const SphereProjector& sphere_projector) const;
+		// Подложка и текст названия остановки
+		std::vector<svg::Text> RenderSvgStopLabels(const domain::Stop& stop, const SphereProjector& sphere_projector) const;
 
 		svg::Text RenderSvgBusText(const std::string& text,
 			svg::Point text_coordinates,
@@ -0,0 +1,326 @@
+#include "mapped_catalogue.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped_catalogue {
+
+	using namespace std::literals;
+
+	namespace {
+		constexpr char FORMAT_MAGIC[4] = { 'T', 'C', 'M', 'M' };
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		constexpr size_t SECTION_ALIGNMENT = 8;
+
+		static_assert(std::is_trivially_copyable_v<layout::Header>);
+		static_assert(std::is_trivially_copyable_v<layout::Stop>);
+		static_assert(std::is_trivially_copyable_v<layout::Bus>);
+		static_assert(std::is_trivially_copyable_v<layout::Distance>);
+		static_assert(sizeof(layout::Stop) % SECTION_ALIGNMENT == 0);
+		static_assert(sizeof(layout::Bus) % SECTION_ALIGNMENT == 0);
+		static_assert(sizeof(layout::Distance) % SECTION_ALIGNMENT == 0);
+
+		template <typename Record>
+		layout::Section AppendSection(std::string& image, const std::vector<Record>& records) {
+			image.resize((image.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, '\0');
+			layout::Section section{ image.size(), records.size() };
+			image.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+			return section;
+		}
+
+		layout::Section AppendSection(std::string& image, std::string_view bytes) {
+			return AppendSection(image, std::vector<char>(bytes.begin(), bytes.end()));
+		}
+
+		template <typename Record>
+		bool IsSectionValid(const layout::Section& section, size_t file_size) {
+			return section.offset % SECTION_ALIGNMENT == 0
+				&& section.offset <= file_size
+				&& section.count <= (file_size - section.offset) / sizeof(Record);
+		}
+	}
+
+	void WriteMappedBase(const transport_catalogue::TransportCatalogue& catalogue,
+	                     const map_renderer::RenderSettings& render_settings,
+	                     std::ostream& output) {
+		const auto& stops = catalogue.GetStopsList();
+		const auto& buses = catalogue.GetBusesList();
+
+		std::string strings;
+		std::vector<layout::Stop> stop_records;
+		std::vector<uint32_t> stop_buses;
+		stop_records.reserve(stops.size());
+		for (const auto& stop : stops) {
+			const uint32_t buses_begin = static_cast<uint32_t>(stop_buses.size());
+			for (const auto& bus_name : catalogue.GetBusesForStop(stop.stop_name)) {
+				stop_buses.push_back(static_cast<uint32_t>(catalogue.FindBus(bus_name)->bus_id));
+			}
+			stop_records.push_back({ static_cast<uint32_t>(strings.size()),
+			                         static_cast<uint32_t>(stop.stop_name.size()),
+			                         stop.stop_coordinates.lat,
+			                         stop.stop_coordinates.lng,
+			                         buses_begin,
+			                         static_cast<uint32_t>(stop_buses.size()) - buses_begin });
+			strings += stop.stop_name;
+		}
+
+		std::vector<layout::Bus> bus_records;
+		std::vector<uint32_t> route_stops;
+		bus_records.reserve(buses.size());
+		for (const auto& bus : buses) {
+			const auto bus_information = catalogue.GetBusInformation(&bus);
+			bus_records.push_back({ static_cast<uint32_t>(strings.size()),
+			                        static_cast<uint32_t>(bus.bus_name.size()),
+			                        static_cast<uint32_t>(route_stops.size()),
+			                        static_cast<uint32_t>(bus.bus_stops.size()),
+			                        bus.is_roundtrip ? 1u : 0u,
+			                        bus_information.stops_on_bus_route,
+			                        bus_information.unique_bus_stops,
+			                        bus_information.bus_route_length,
+			                        bus_information.geografical_bus_route_length });
+			strings += bus.bus_name;
+			for (const auto& stop : bus.bus_stops) {
+				route_stops.push_back(static_cast<uint32_t>(stop->stop_id));
+			}
+		}
+
+		std::vector<uint32_t> stops_by_name(stops.size());
+		std::iota(stops_by_name.begin(), stops_by_name.end(), 0);
+		std::sort(stops_by_name.begin(), stops_by_name.end(), [&stops](uint32_t lhs, uint32_t rhs) {
+			return stops[lhs].stop_name < stops[rhs].stop_name;
+		});
+		std::vector<uint32_t> buses_by_name(buses.size());
+		std::iota(buses_by_name.begin(), buses_by_name.end(), 0);
+		std::sort(buses_by_name.begin(), buses_by_name.end(), [&buses](uint32_t lhs, uint32_t rhs) {
+			return buses[lhs].bus_name < buses[rhs].bus_name;
+		});
+
+		std::vector<layout::Distance> distances;
+		distances.reserve(catalogue.GetDistances().size());
+		for (const auto& [stops_pair, distance] : catalogue.GetDistances()) {
+			// Как и в двоичной базе, расстояние без одной из остановок не записывается
+			if (stops_pair.first == nullptr || stops_pair.second == nullptr) {
+				continue;
+			}
+			distances.push_back({ static_cast<uint32_t>(stops_pair.first->stop_id),
+			                      static_cast<uint32_t>(stops_pair.second->stop_id),
+			                      distance,
+			                      0 });
+		}
+		std::sort(distances.begin(), distances.end(), [](const layout::Distance& lhs, const layout::Distance& rhs) {
+			return std::pair{ lhs.from_stop_id, lhs.to_stop_id } < std::pair{ rhs.from_stop_id, rhs.to_stop_id };
+		});
+
+		const std::string serialized_render_settings = serialization::SerializeRenderSettings(render_settings);
+
+		layout::Header header{};
+		std::memcpy(header.magic, FORMAT_MAGIC, sizeof(FORMAT_MAGIC));
+		header.version = layout::FORMAT_VERSION;
+		header.byte_order_mark = BYTE_ORDER_MARK;
+
+		std::string image(sizeof(layout::Header), '\0');
+		header.strings = AppendSection(image, strings);
+		header.stops = AppendSection(image, stop_records);
+		header.stops_by_name = AppendSection(image, stops_by_name);
+		header.stop_buses = AppendSection(image, stop_buses);
+		header.buses = AppendSection(image, bus_records);
+		header.buses_by_name = AppendSection(image, buses_by_name);
+		header.route_stops = AppendSection(image, route_stops);
+		header.distances = AppendSection(image, distances);
+		header.render_settings = AppendSection(image, serialized_render_settings);
+		std::memcpy(image.data(), &header, sizeof(header));
+
+		output.write(image.data(), static_cast<std::streamsize>(image.size()));
+		if (!output) {
+			throw serialization::SerializationError("Failed to write mapped base file"s);
+		}
+	}
+
+	MappedCatalogue::MappedCatalogue(const std::filesystem::path& file) {
+		const int descriptor = ::open(file.c_str(), O_RDONLY);
+		if (descriptor < 0) {
+			throw serialization::SerializationError("Failed to open mapped base file "s + file.string());
+		}
+		struct stat file_stat {};
+		if (::fstat(descriptor, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(layout::Header))) {
+			::close(descriptor);
+			throw serialization::SerializationError("File is not a mapped transport catalogue base"s);
+		}
+		size_ = static_cast<size_t>(file_stat.st_size);
+		void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+		// Отображение остаётся действительным и после закрытия дескриптора
+		::close(descriptor);
+		if (address == MAP_FAILED) {
+			throw serialization::SerializationError("Failed to map base file "s + file.string());
+		}
+		data_ = static_cast<const char*>(address);
+		header_ = reinterpret_cast<const layout::Header*>(data_);
+
+		try {
+			CheckLayout();
+		}
+		catch (...) {
+			::munmap(const_cast<char*>(data_), size_);
+			throw;
+		}
+	}
+
+	MappedCatalogue::~MappedCatalogue() {
+		::munmap(const_cast<char*>(data_), size_);
+	}
+
+	void MappedCatalogue::CheckLayout() const {
+		if (std::memcmp(header_->magic, FORMAT_MAGIC, sizeof(FORMAT_MAGIC)) != 0) {
+			throw serialization::SerializationError("File is not a mapped transport catalogue base"s);
+		}
+		if (header_->version != layout::FORMAT_VERSION) {
+			throw serialization::SerializationError("Unsupported mapped base file version"s);
+		}
+		if (header_->byte_order_mark != BYTE_ORDER_MARK) {
+			throw serialization::SerializationError("Mapped base file was written with another byte order"s);
+		}
+		// Проверяются только границы таблиц: обход записей заставил бы прочитать весь файл при открытии
+		if (!IsSectionValid<char>(header_->strings, size_)
+			|| !IsSectionValid<layout::Stop>(header_->stops, size_)
+			|| !IsSectionValid<uint32_t>(header_->stops_by_name, size_)
+			|| !IsSectionValid<uint32_t>(header_->stop_buses, size_)
+			|| !IsSectionValid<layout::Bus>(header_->buses, size_)
+			|| !IsSectionValid<uint32_t>(header_->buses_by_name, size_)
+			|| !IsSectionValid<uint32_t>(header_->route_stops, size_)
+			|| !IsSectionValid<layout::Distance>(header_->distances, size_)
+			|| !IsSectionValid<char>(header_->render_settings, size_)
+			|| header_->stops_by_name.count != header_->stops.count
+			|| header_->buses_by_name.count != header_->buses.count) {
+			throw serialization::SerializationError("Mapped base file is corrupted"s);
+		}
+	}
+
+	std::string_view MappedCatalogue::GetString(uint32_t offset, uint32_t size) const {
+		return { GetSection<char>(header_->strings) + offset, size };
+	}
+
+	std::optional<uint32_t> MappedCatalogue::FindStop(std::string_view stop_name) const {
+		const uint32_t* begin = GetSection<uint32_t>(header_->stops_by_name);
+		const uint32_t* end = begin + header_->stops_by_name.count;
+		const uint32_t* it = std::lower_bound(begin, end, stop_name, [this](uint32_t stop_id, std::string_view name) {
+			return GetStopName(stop_id) < name;
+		});
+		if (it == end || GetStopName(*it) != stop_name) {
+			return std::nullopt;
+		}
+		return *it;
+	}
+
+	std::optional<uint32_t> MappedCatalogue::FindBus(std::string_view bus_name) const {
+		const uint32_t* begin = GetSection<uint32_t>(header_->buses_by_name);
+		const uint32_t* end = begin + header_->buses_by_name.count;
+		const uint32_t* it = std::lower_bound(begin, end, bus_name, [this](uint32_t bus_id, std::string_view name) {
+			return GetBusName(bus_id) < name;
+		});
+		if (it == end || GetBusName(*it) != bus_name) {
+			return std::nullopt;
+		}
+		return *it;
+	}
+
+	size_t MappedCatalogue::GetStopsCount() const {
+		return static_cast<size_t>(header_->stops.count);
+	}
+
+	size_t MappedCatalogue::GetBusesCount() const {
+		return static_cast<size_t>(header_->buses.count);
+	}
+
+	std::string_view MappedCatalogue::GetStopName(uint32_t stop_id) const {
+		const layout::Stop& stop = GetSection<layout::Stop>(header_->stops)[stop_id];
+		return GetString(stop.name_offset, stop.name_size);
+	}
+
+	geo::Coordinates MappedCatalogue::GetStopCoordinates(uint32_t stop_id) const {
+		const layout::Stop& stop = GetSection<layout::Stop>(header_->stops)[stop_id];
+		return { stop.lat, stop.lng };
+	}
+
+	std::string_view MappedCatalogue::GetBusName(uint32_t bus_id) const {
+		const layout::Bus& bus = GetSection<layout::Bus>(header_->buses)[bus_id];
+		return GetString(bus.name_offset, bus.name_size);
+	}
+
+	domain::Bus_Information MappedCatalogue::GetBusInformation(uint32_t bus_id) const {
+		const layout::Bus& bus = GetSection<layout::Bus>(header_->buses)[bus_id];
+		return { std::string{ GetBusName(bus_id) },
+		         bus.stops_on_bus_route,
+		         bus.unique_bus_stops,
+		         bus.bus_route_length,
+		         bus.geografical_bus_route_length,
+		         static_cast<double>(bus.bus_route_length) / bus.geografical_bus_route_length };
+	}
+
+	std::vector<std::string_view> MappedCatalogue::GetBusesForStop(uint32_t stop_id) const {
+		const layout::Stop& stop = GetSection<layout::Stop>(header_->stops)[stop_id];
+		const uint32_t* stop_buses = GetSection<uint32_t>(header_->stop_buses) + stop.buses_begin;
+		std::vector<std::string_view> buses;
+		buses.reserve(stop.buses_count);
+		for (uint32_t i = 0; i < stop.buses_count; ++i) {
+			buses.push_back(GetBusName(stop_buses[i]));
+		}
+		return buses;
+	}
+
+	std::optional<int> MappedCatalogue::GetDistanceBetweenStops(uint32_t from_stop_id, uint32_t to_stop_id) const {
+		const layout::Distance* begin = GetSection<layout::Distance>(header_->distances);
+		const layout::Distance* end = begin + header_->distances.count;
+		auto find_distance = [begin, end](uint32_t from, uint32_t to) -> std::optional<int> {
+			const layout::Distance* it = std::lower_bound(begin, end, std::pair{ from, to },
+				[](const layout::Distance& distance, const std::pair<uint32_t, uint32_t>& stops) {
+					return std::pair{ distance.from_stop_id, distance.to_stop_id } < stops;
+				});
+			if (it == end || it->from_stop_id != from || it->to_stop_id != to) {
+				return std::nullopt;
+			}
+			return it->distance;
+		};
+		if (auto distance = find_distance(from_stop_id, to_stop_id)) {
+			return distance;
+		}
+		return find_distance(to_stop_id, from_stop_id);
+	}
+
+	map_renderer::RenderSettings MappedCatalogue::GetRenderSettings() const {
+		return serialization::DeserializeRenderSettings({ GetSection<char>(header_->render_settings),
+		                                                  static_cast<size_t>(header_->render_settings.count) });
+	}
+
+	void MappedCatalogue::Materialize(transport_catalogue::TransportCatalogue& catalogue) const {
+		for (uint32_t stop_id = 0; stop_id < GetStopsCount(); ++stop_id) {
+			catalogue.AddStop(std::string{ GetStopName(stop_id) }, GetStopCoordinates(stop_id));
+		}
+		const layout::Bus* buses = GetSection<layout::Bus>(header_->buses);
+		const uint32_t* route_stops = GetSection<uint32_t>(header_->route_stops);
+		for (uint32_t bus_id = 0; bus_id < GetBusesCount(); ++bus_id) {
+			std::vector<std::string_view> bus_stops;
+			bus_stops.reserve(buses[bus_id].stops_count);
+			for (uint32_t i = 0; i < buses[bus_id].stops_count; ++i) {
+				bus_stops.push_back(GetStopName(route_stops[buses[bus_id].stops_begin + i]));
+			}
+			catalogue.AddBus(std::string{ GetBusName(bus_id) }, bus_stops, buses[bus_id].is_roundtrip != 0);
+		}
+		const auto& stops = catalogue.GetStopsList();
+		const layout::Distance* distances = GetSection<layout::Distance>(header_->distances);
+		for (uint64_t i = 0; i < header_->distances.count; ++i) {
+			catalogue.SetDistanceBetweenStops(&stops[distances[i].from_stop_id],
+			                                  &stops[distances[i].to_stop_id],
+			                                  distances[i].distance);
+		}
+		catalogue.BuildIndexes();
+	}
+}
\ No newline at end of file
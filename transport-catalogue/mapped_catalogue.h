@@ -0,0 +1,130 @@
+#pragma once
+
+#include "domain.h"
+#include "geo.h"
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace mapped_catalogue {
+
+	// Образ справочника, не зависящий от адреса загрузки: все ссылки внутри файла - смещения
+	// от его начала или индексы в таблицах. Таблицы выровнены по 8 байтам и читаются напрямую
+	// из отображённых страниц, поэтому процессы, открывшие один файл, делят одну копию в page cache
+	namespace layout {
+
+		inline constexpr uint32_t FORMAT_VERSION = 1;
+
+		struct Section {
+			uint64_t offset = 0;
+			uint64_t count = 0;
+		};
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint32_t byte_order_mark;
+			uint32_t reserved;
+			Section strings;          // char
+			Section stops;            // Stop
+			Section stops_by_name;    // uint32_t stop_id, по возрастанию названия
+			Section stop_buses;       // uint32_t bus_id, для каждой остановки по возрастанию названия маршрута
+			Section buses;            // Bus
+			Section buses_by_name;    // uint32_t bus_id, по возрастанию названия
+			Section route_stops;      // uint32_t stop_id, остановки маршрутов подряд
+			Section distances;        // Distance, по возрастанию (from_stop_id, to_stop_id)
+			Section render_settings;  // char, настройки визуализации в формате serialization
+		};
+
+		struct Stop {
+			uint32_t name_offset;
+			uint32_t name_size;
+			double lat;
+			double lng;
+			uint32_t buses_begin;
+			uint32_t buses_count;
+		};
+
+		struct Bus {
+			uint32_t name_offset;
+			uint32_t name_size;
+			uint32_t stops_begin;
+			uint32_t stops_count;
+			uint32_t is_roundtrip;
+			int32_t stops_on_bus_route;
+			int32_t unique_bus_stops;
+			int32_t bus_route_length;
+			double geografical_bus_route_length;
+		};
+
+		struct Distance {
+			uint32_t from_stop_id;
+			uint32_t to_stop_id;
+			int32_t distance;
+			uint32_t reserved;
+		};
+	}
+
+	// Записывает образ справочника; индексы справочника должны быть построены
+	void WriteMappedBase(const transport_catalogue::TransportCatalogue& catalogue,
+	                     const map_renderer::RenderSettings& render_settings,
+	                     std::ostream& output);
+
+	// Справочник только для чтения, отвечающий на запросы прямо из отображённого в память файла
+	class MappedCatalogue {
+	public:
+		explicit MappedCatalogue(const std::filesystem::path& file);
+
+		MappedCatalogue(const MappedCatalogue&) = delete;
+		MappedCatalogue& operator=(const MappedCatalogue&) = delete;
+
+		~MappedCatalogue();
+
+		std::optional<uint32_t> FindStop(std::string_view stop_name) const;
+
+		std::optional<uint32_t> FindBus(std::string_view bus_name) const;
+
+		size_t GetStopsCount() const;
+
+		size_t GetBusesCount() const;
+
+		std::string_view GetStopName(uint32_t stop_id) const;
+
+		geo::Coordinates GetStopCoordinates(uint32_t stop_id) const;
+
+		std::string_view GetBusName(uint32_t bus_id) const;
+
+		domain::Bus_Information GetBusInformation(uint32_t bus_id) const;
+
+		// Названия маршрутов через остановку в лексикографическом порядке
+		std::vector<std::string_view> GetBusesForStop(uint32_t stop_id) const;
+
+		std::optional<int> GetDistanceBetweenStops(uint32_t from_stop_id, uint32_t to_stop_id) const;
+
+		map_renderer::RenderSettings GetRenderSettings() const;
+
+		// Разворачивает образ в обычный справочник для запросов, которым нужны его индексы
+		void Materialize(transport_catalogue::TransportCatalogue& catalogue) const;
+
+	private:
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+		const layout::Header* header_ = nullptr;
+
+		template <typename Record>
+		const Record* GetSection(const layout::Section& section) const {
+			return reinterpret_cast<const Record*>(data_ + section.offset);
+		}
+
+		std::string_view GetString(uint32_t offset, uint32_t size) const;
+
+		void CheckLayout() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "memory_usage.h"
+
+#include <iomanip>
+
+namespace memory_usage {
+
+	using namespace std::literals;
+
+	void Report::Add(std::string name, size_t elements, size_t bytes) {
+		components.push_back({ std::move(name), elements, bytes });
+	}
+
+	size_t Report::GetTotalBytes() const {
+		size_t total_bytes = 0;
+		for (const Component& component : components) {
+			total_bytes += component.bytes;
+		}
+		return total_bytes;
+	}
+
+	void PrintReport(std::string_view title, const Report& report, std::ostream& output) {
+		output << std::left << std::setw(32) << title << std::right
+		       << std::setw(12) << "elements"sv << std::setw(14) << "KB"sv << '\n';
+		output << std::fixed << std::setprecision(1);
+		for (const Component& component : report.components) {
+			output << std::left << std::setw(32) << component.name << std::right
+			       << std::setw(12) << component.elements
+			       << std::setw(14) << static_cast<double>(component.bytes) / 1024 << '\n';
+		}
+		output << std::left << std::setw(32) << "total"sv << std::right << std::setw(12) << ""sv
+		       << std::setw(14) << static_cast<double>(report.GetTotalBytes()) / 1024 << '\n'
+		       << std::defaultfloat;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Оценка памяти, занятой контейнерами, по устройству libstdc++ на 64-битной платформе.
+// Учитывается память самих контейнеров и их узлов, но не накладные расходы распределителя
+namespace memory_usage {
+
+	struct Component {
+		std::string name;
+		size_t elements = 0;
+		size_t bytes = 0;
+	};
+
+	struct Report {
+		std::vector<Component> components;
+
+		void Add(std::string name, size_t elements, size_t bytes);
+
+		size_t GetTotalBytes() const;
+	};
+
+	void PrintReport(std::string_view title, const Report& report, std::ostream& output);
+
+	namespace detail {
+		constexpr size_t POINTER_SIZE = sizeof(void*);
+		// Заголовок узла красно-чёрного дерева: цвет и три указателя
+		constexpr size_t TREE_NODE_HEADER_SIZE = 4 * POINTER_SIZE;
+		constexpr size_t DEQUE_BLOCK_SIZE = 512;
+
+		constexpr size_t AlignToPointer(size_t size) {
+			return (size + POINTER_SIZE - 1) / POINTER_SIZE * POINTER_SIZE;
+		}
+	}
+
+	// Память строки вне объекта: короткие строки хранятся внутри объекта
+	inline size_t GetHeapBytes(const std::string& value) {
+		return value.capacity() > 15 ? value.capacity() + 1 : 0;
+	}
+
+	template <typename Value>
+	size_t GetHeapBytes(const std::vector<Value>& values) {
+		return values.capacity() * sizeof(Value);
+	}
+
+	template <typename Value>
+	size_t GetHeapBytes(const std::deque<Value>& values) {
+		const size_t block_elements = sizeof(Value) < detail::DEQUE_BLOCK_SIZE ? detail::DEQUE_BLOCK_SIZE / sizeof(Value) : 1;
+		const size_t blocks_count = values.size() / block_elements + 1;
+		return blocks_count * block_elements * sizeof(Value) + (blocks_count + 2) * detail::POINTER_SIZE;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Equal>
+	size_t GetHeapBytes(const std::unordered_map<Key, Value, Hasher, Equal>& values) {
+		// Узел хранит указатель на следующий узел, пару и закэшированный хеш
+		const size_t node_size = detail::AlignToPointer(detail::POINTER_SIZE + sizeof(std::pair<const Key, Value>) + sizeof(size_t));
+		return values.bucket_count() * detail::POINTER_SIZE + values.size() * node_size;
+	}
+
+	template <typename Key, typename Value, typename Compare>
+	size_t GetHeapBytes(const std::map<Key, Value, Compare>& values) {
+		return values.size() * (detail::TREE_NODE_HEADER_SIZE + detail::AlignToPointer(sizeof(std::pair<const Key, Value>)));
+	}
+
+	template <typename Key, typename Compare>
+	size_t GetHeapBytes(const std::set<Key, Compare>& values) {
+		return values.size() * (detail::TREE_NODE_HEADER_SIZE + detail::AlignToPointer(sizeof(Key)));
+	}
+}
\ No newline at end of file
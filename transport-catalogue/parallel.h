@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+	// Делит [0, count) на threads_count непрерывных частей и вызывает function(chunk_index, begin, end)
+	// для каждой части в своём потоке (последние части могут оказаться пустыми); первая часть
+	// обрабатывается в вызывающем потоке.
+	// Исключение из любой части пробрасывается после завершения всех потоков
+	template <typename Function>
+	void ForEachChunk(size_t count, size_t threads_count, Function function) {
+		threads_count = std::max<size_t>(std::min(threads_count, count), 1);
+		const size_t chunk_size = (count + threads_count - 1) / threads_count;
+		std::vector<std::exception_ptr> errors(threads_count);
+		auto run_chunk = [&](size_t chunk_index) {
+			const size_t begin = std::min(chunk_index * chunk_size, count);
+			const size_t end = std::min(begin + chunk_size, count);
+			try {
+				function(chunk_index, begin, end);
+			}
+			catch (...) {
+				errors[chunk_index] = std::current_exception();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threads_count - 1);
+		for (size_t chunk_index = 1; chunk_index < threads_count; ++chunk_index) {
+			threads.emplace_back(run_chunk, chunk_index);
+		}
+		run_chunk(0);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		for (const auto& error : errors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <iterator>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace profiler {
+
+	using namespace std::literals;
+
+	PerfSample operator-(const PerfSample& left, const PerfSample& right) {
+		return { left.cycles - right.cycles,
+		         left.instructions - right.instructions,
+		         left.cache_references - right.cache_references,
+		         left.cache_misses - right.cache_misses,
+		         left.branches - right.branches,
+		         left.branch_misses - right.branch_misses };
+	}
+
+	PerfSample& operator+=(PerfSample& left, const PerfSample& right) {
+		left.cycles += right.cycles;
+		left.instructions += right.instructions;
+		left.cache_references += right.cache_references;
+		left.cache_misses += right.cache_misses;
+		left.branches += right.branches;
+		left.branch_misses += right.branch_misses;
+		return left;
+	}
+
+#ifdef __linux__
+
+	namespace {
+		// Порядок совпадает с полями PerfSample
+		constexpr uint64_t COUNTERS_CONFIGS[] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_REFERENCES,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+			PERF_COUNT_HW_BRANCH_MISSES,
+		};
+
+		int OpenCounter(uint64_t config) {
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.size = sizeof(attributes);
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = config;
+			attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			// pid = 0, cpu = -1: вызывающий поток на любом процессоре
+			return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+		}
+
+		uint64_t ReadCounter(int descriptor) {
+			struct {
+				uint64_t value;
+				uint64_t time_enabled;
+				uint64_t time_running;
+			} counter{};
+			if (read(descriptor, &counter, sizeof(counter)) != static_cast<ssize_t>(sizeof(counter))
+			    || counter.time_running == 0) {
+				return 0;
+			}
+			if (counter.time_running == counter.time_enabled) {
+				return counter.value;
+			}
+			return static_cast<uint64_t>(static_cast<long double>(counter.value) * counter.time_enabled / counter.time_running);
+		}
+	}
+
+	PerfCounters::PerfCounters() {
+		descriptors_.fill(-1);
+		static_assert(std::size(COUNTERS_CONFIGS) == COUNTERS_COUNT);
+		for (size_t i = 0; i < COUNTERS_COUNT; ++i) {
+			descriptors_[i] = OpenCounter(COUNTERS_CONFIGS[i]);
+			if (descriptors_[i] < 0) {
+				error_ = "perf_event_open: "s + std::strerror(errno);
+				break;
+			}
+		}
+		if (!error_.empty()) {
+			for (int& descriptor : descriptors_) {
+				if (descriptor >= 0) {
+					close(descriptor);
+				}
+				descriptor = -1;
+			}
+		}
+	}
+
+	PerfCounters::~PerfCounters() {
+		for (int descriptor : descriptors_) {
+			if (descriptor >= 0) {
+				close(descriptor);
+			}
+		}
+	}
+
+	PerfSample PerfCounters::Read() const {
+		if (!IsAvailable()) {
+			return {};
+		}
+		return { ReadCounter(descriptors_[0]),
+		         ReadCounter(descriptors_[1]),
+		         ReadCounter(descriptors_[2]),
+		         ReadCounter(descriptors_[3]),
+		         ReadCounter(descriptors_[4]),
+		         ReadCounter(descriptors_[5]) };
+	}
+
+#else
+
+	PerfCounters::PerfCounters()
+		:error_("perf_event_open is only available on Linux"s)
+	{
+		descriptors_.fill(-1);
+	}
+
+	PerfCounters::~PerfCounters() = default;
+
+	PerfSample PerfCounters::Read() const {
+		return {};
+	}
+
+#endif
+
+	bool PerfCounters::IsAvailable() const {
+		return error_.empty();
+	}
+
+	const std::string& PerfCounters::GetError() const {
+		return error_;
+	}
+}
\ No newline at end of file
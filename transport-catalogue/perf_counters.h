@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace profiler {
+
+	struct PerfSample {
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		uint64_t cache_references = 0;
+		uint64_t cache_misses = 0;
+		uint64_t branches = 0;
+		uint64_t branch_misses = 0;
+	};
+
+	PerfSample operator-(const PerfSample& left, const PerfSample& right);
+	PerfSample& operator+=(PerfSample& left, const PerfSample& right);
+
+	// Аппаратные счётчики вызывающего потока через perf_event_open (только Linux, без событий ядра).
+	// Счётчики открываются независимо; если ядро мультиплексирует их, значения масштабируются
+	// по доле времени, когда счётчик работал. Если открыть счётчики не удалось, IsAvailable() ложно,
+	// а причину возвращает GetError()
+	class PerfCounters {
+	public:
+		PerfCounters();
+		~PerfCounters();
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+		bool IsAvailable() const;
+		const std::string& GetError() const;
+
+		PerfSample Read() const;
+
+	private:
+		static constexpr size_t COUNTERS_COUNT = 6;
+
+		std::array<int, COUNTERS_COUNT> descriptors_;
+		std::string error_;
+	};
+}
\ No newline at end of file
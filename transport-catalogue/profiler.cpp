@@ -0,0 +1,361 @@
+#include "profiler.h"
+#include "json.h"
+#include "json_builder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+#include <sys/resource.h>
+
+namespace profiler {
+
+	using namespace std::literals;
+
+	namespace {
+		double ToMilliseconds(std::chrono::steady_clock::duration duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		double GetItemsPerSecond(const PhaseStatistics& phase) {
+			const double seconds = std::chrono::duration<double>(phase.duration).count();
+			return seconds > 0 ? static_cast<double>(phase.items) / seconds : 0.0;
+		}
+
+		// Целые числа JSON-документа ограничены типом int
+		int ToJsonCount(uint64_t count) {
+			return static_cast<int>(std::min<uint64_t>(count, std::numeric_limits<int>::max()));
+		}
+
+		double ToMicroseconds(uint64_t nanoseconds) {
+			return static_cast<double>(nanoseconds) / 1000.0;
+		}
+
+		// Типы запросов, у которых есть своя фаза; тип приходит от клиента,
+		// поэтому остальные собираются в одну фазу, и число фаз не растёт
+		constexpr std::string_view KNOWN_REQUEST_TYPES[] = {
+			"Bus"sv, "BusesNearby"sv, "Map"sv, "RouteDistance"sv, "Search"sv, "Stop"sv, "Transfers"sv, "Update"sv
+		};
+
+		struct LatencyPercentile {
+			std::string_view key;
+			std::string_view title;
+			double percentile;
+		};
+
+		constexpr LatencyPercentile LATENCY_PERCENTILES[] = {
+			{ "p50_us"sv, "p50 us"sv, 50.0 },
+			{ "p90_us"sv, "p90 us"sv, 90.0 },
+			{ "p99_us"sv, "p99 us"sv, 99.0 },
+			{ "p99_9_us"sv, "p99.9 us"sv, 99.9 },
+		};
+
+		std::atomic<uint64_t> next_profiler_id{ 1 };
+
+		double GetRatio(uint64_t numerator, uint64_t denominator) {
+			return denominator > 0 ? static_cast<double>(numerator) / static_cast<double>(denominator) : 0.0;
+		}
+
+		std::string MakePhaseName(std::string_view name, std::string_view detail) {
+			std::string full_name(name);
+			if (!detail.empty()) {
+				full_name.append("."sv).append(detail);
+			}
+			return full_name;
+		}
+	}
+
+	size_t GetPeakRss() {
+		rusage usage{};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) {
+			return 0;
+		}
+		// ru_maxrss в Linux измеряется в килобайтах
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+	}
+
+	Profiler::Phase::Phase(Profiler* profiler, std::string_view name, std::string_view detail, size_t items)
+		:Phase(profiler, name, detail, items, false)
+	{
+	}
+
+	Profiler::Phase::Phase(Profiler* profiler, std::string_view name, std::string_view detail, size_t items,
+	                       bool record_latency)
+		:profiler_(profiler), name_(name), detail_(detail), items_(items), record_latency_(record_latency)
+	{
+		if (profiler_) {
+			perf_counters_ = profiler_->GetThreadPerfCounters();
+			start_allocations_ = GetThreadAllocations();
+			if (perf_counters_) {
+				start_perf_ = perf_counters_->Read();
+			}
+			start_ = std::chrono::steady_clock::now();
+		}
+	}
+
+	Profiler::Phase::~Phase() {
+		if (profiler_) {
+			const auto duration = std::chrono::steady_clock::now() - start_;
+			const PerfSample perf = perf_counters_ ? perf_counters_->Read() - start_perf_ : PerfSample{};
+			const AllocationStatistics allocations = GetThreadAllocations();
+			profiler_->AddPhase(name_, detail_, items_, duration,
+			                    { allocations.allocations - start_allocations_.allocations,
+			                      allocations.bytes - start_allocations_.bytes },
+			                    perf);
+			if (record_latency_) {
+				profiler_->RecordLatency(detail_, duration);
+			}
+			if (profiler_->IsTraceEnabled()) {
+				profiler_->RecordTraceEvent(name_, detail_, start_, duration);
+			}
+		}
+	}
+
+	Profiler::Phase Profiler::Phase::ForRequest(Profiler* profiler, std::string_view request_type) {
+		const auto known_type = std::find(std::begin(KNOWN_REQUEST_TYPES), std::end(KNOWN_REQUEST_TYPES), request_type);
+		const std::string_view phase_type = known_type != std::end(KNOWN_REQUEST_TYPES) ? *known_type : "unknown"sv;
+		return Phase(profiler, "stat_request"sv, phase_type, 1, true);
+	}
+
+	void Profiler::Phase::SetItems(size_t items) {
+		items_ = items;
+	}
+
+	Profiler::Profiler(ProfilerSettings settings)
+		:profiler_id_(next_profiler_id.fetch_add(1, std::memory_order_relaxed))
+		, settings_(settings)
+		, start_time_(std::chrono::steady_clock::now())
+	{
+		EnableAllocationCounting();
+	}
+
+	void Profiler::AddPhase(std::string_view name, std::string_view detail, size_t items,
+	                        std::chrono::steady_clock::duration duration, AllocationStatistics allocations,
+	                        PerfSample perf) {
+		std::string full_name = MakePhaseName(name, detail);
+		const size_t peak_rss = GetPeakRss();
+		std::lock_guard guard(phases_mutex_);
+		auto position = phases_indexes_.find(full_name);
+		if (position == phases_indexes_.end()) {
+			position = phases_indexes_.emplace(full_name, phases_.size()).first;
+			phases_.push_back({ std::move(full_name) });
+		}
+		PhaseStatistics& phase = phases_[position->second];
+		++phase.calls;
+		phase.items += items;
+		phase.duration += duration;
+		phase.peak_rss = std::max(phase.peak_rss, peak_rss);
+		phase.allocations.allocations += allocations.allocations;
+		phase.allocations.bytes += allocations.bytes;
+		phase.perf += perf;
+	}
+
+	std::vector<PhaseStatistics> Profiler::GetPhases() const {
+		std::lock_guard guard(phases_mutex_);
+		return phases_;
+	}
+
+	bool Profiler::IsTraceEnabled() const {
+		return settings_.trace;
+	}
+
+	const PerfCounters* Profiler::GetThreadPerfCounters() {
+		if (!settings_.perf_counters) {
+			return nullptr;
+		}
+		ThreadShard& shard = GetThreadShard();
+		return shard.perf_counters && shard.perf_counters->IsAvailable() ? shard.perf_counters.get() : nullptr;
+	}
+
+	void Profiler::RecordTraceEvent(std::string_view name, std::string_view detail,
+	                                std::chrono::steady_clock::time_point start,
+	                                std::chrono::steady_clock::duration duration) {
+		GetThreadShard().trace_events.push_back({ MakePhaseName(name, detail), name, start - start_time_, duration });
+	}
+
+	Profiler::ThreadShard& Profiler::GetThreadShard() {
+		// Идентификатор, а не адрес профилировщика: адрес может достаться новому объекту
+		thread_local std::unordered_map<uint64_t, ThreadShard*> thread_shards;
+		ThreadShard*& shard = thread_shards[profiler_id_];
+		if (!shard) {
+			std::lock_guard guard(thread_shards_mutex_);
+			shard = thread_shards_.emplace_back(std::make_unique<ThreadShard>()).get();
+			shard->thread_index = thread_shards_.size();
+			if (settings_.perf_counters) {
+				// Счётчики perf_event_open привязаны к потоку, который их открыл
+				shard->perf_counters = std::make_unique<PerfCounters>();
+				if (!shard->perf_counters->IsAvailable() && perf_error_.empty()) {
+					perf_error_ = shard->perf_counters->GetError();
+				}
+			}
+		}
+		return *shard;
+	}
+
+	void Profiler::RecordLatency(std::string_view request_type, std::chrono::steady_clock::duration duration) {
+		auto& histograms = GetThreadShard().latency_histograms;
+		auto position = histograms.find(request_type);
+		if (position == histograms.end()) {
+			position = histograms.emplace(std::string(request_type), LatencyHistogram{}).first;
+		}
+		const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		position->second.Record(static_cast<uint64_t>(std::max<decltype(nanoseconds)>(nanoseconds, 0)));
+	}
+
+	std::map<std::string, LatencyHistogram> Profiler::GetLatencyHistograms() const {
+		std::map<std::string, LatencyHistogram> merged_histograms;
+		std::lock_guard guard(thread_shards_mutex_);
+		for (const auto& shard : thread_shards_) {
+			for (const auto& [request_type, histogram] : shard->latency_histograms) {
+				merged_histograms[request_type].Merge(histogram);
+			}
+		}
+		return merged_histograms;
+	}
+
+	void Profiler::AddMemoryUsage(std::string title, memory_usage::Report report) {
+		std::lock_guard guard(phases_mutex_);
+		memory_usages_.emplace_back(std::move(title), std::move(report));
+	}
+
+	void Profiler::PrintReport(std::ostream& output) const {
+		output << std::left << std::setw(32) << "phase"sv << std::right
+		       << std::setw(10) << "calls"sv << std::setw(12) << "items"sv
+		       << std::setw(12) << "time ms"sv << std::setw(14) << "items/s"sv
+		       << std::setw(14) << "peak RSS MB"sv << std::setw(12) << "allocs"sv
+		       << std::setw(14) << "alloc KB"sv << '\n';
+		for (const PhaseStatistics& phase : GetPhases()) {
+			output << std::left << std::setw(32) << phase.name << std::right
+			       << std::setw(10) << phase.calls << std::setw(12) << phase.items
+			       << std::setw(12) << std::fixed << std::setprecision(3) << ToMilliseconds(phase.duration)
+			       << std::setw(14) << std::setprecision(0) << GetItemsPerSecond(phase)
+			       << std::setw(14) << std::setprecision(1) << static_cast<double>(phase.peak_rss) / (1 << 20)
+			       << std::setw(12) << phase.allocations.allocations
+			       << std::setw(14) << static_cast<double>(phase.allocations.bytes) / 1024 << '\n';
+		}
+
+		if (settings_.perf_counters) {
+			PrintPerfReport(output);
+		}
+
+		const auto histograms = GetLatencyHistograms();
+		if (!histograms.empty()) {
+			output << '\n' << std::left << std::setw(32) << "request latency"sv << std::right
+			       << std::setw(10) << "count"sv << std::setw(12) << "mean us"sv;
+			for (const auto& percentile : LATENCY_PERCENTILES) {
+				output << std::setw(12) << percentile.title;
+			}
+			output << std::setw(12) << "max us"sv << '\n';
+			for (const auto& [request_type, histogram] : histograms) {
+				output << std::left << std::setw(32) << request_type << std::right
+				       << std::setw(10) << histogram.GetCount()
+				       << std::setw(12) << std::setprecision(1) << histogram.GetMean() / 1000.0;
+				for (const auto& percentile : LATENCY_PERCENTILES) {
+					output << std::setw(12) << ToMicroseconds(histogram.GetValueAtPercentile(percentile.percentile));
+				}
+				output << std::setw(12) << ToMicroseconds(histogram.GetMax()) << '\n';
+			}
+		}
+		output << std::defaultfloat;
+
+		std::lock_guard guard(phases_mutex_);
+		for (const auto& [title, report] : memory_usages_) {
+			output << '\n';
+			memory_usage::PrintReport(title, report, output);
+		}
+	}
+
+	void Profiler::PrintPerfReport(std::ostream& output) const {
+		{
+			std::lock_guard guard(thread_shards_mutex_);
+			if (!perf_error_.empty()) {
+				output << "\nperf counters unavailable: "sv << perf_error_ << '\n';
+				return;
+			}
+		}
+		output << '\n' << std::left << std::setw(32) << "perf counters"sv << std::right
+		       << std::setw(14) << "Mcycles"sv << std::setw(14) << "Minstr"sv << std::setw(8) << "IPC"sv
+		       << std::setw(14) << "cache miss %"sv << std::setw(14) << "branch miss %"sv << '\n';
+		for (const PhaseStatistics& phase : GetPhases()) {
+			output << std::left << std::setw(32) << phase.name << std::right << std::fixed
+			       << std::setw(14) << std::setprecision(3) << static_cast<double>(phase.perf.cycles) / 1e6
+			       << std::setw(14) << static_cast<double>(phase.perf.instructions) / 1e6
+			       << std::setw(8) << std::setprecision(2) << GetRatio(phase.perf.instructions, phase.perf.cycles)
+			       << std::setw(14) << GetRatio(phase.perf.cache_misses, phase.perf.cache_references) * 100
+			       << std::setw(14) << GetRatio(phase.perf.branch_misses, phase.perf.branches) * 100 << '\n';
+		}
+		output << std::defaultfloat;
+	}
+
+	void Profiler::PrintJsonReport(std::ostream& output) const {
+		json::Builder report;
+		report.StartDict().Key("phases"s).StartArray();
+		for (const PhaseStatistics& phase : GetPhases()) {
+			report.StartDict()
+				.Key("name"s).Value(phase.name)
+				.Key("calls"s).Value(ToJsonCount(phase.calls))
+				.Key("items"s).Value(ToJsonCount(phase.items))
+				.Key("time_ms"s).Value(ToMilliseconds(phase.duration))
+				.Key("items_per_second"s).Value(GetItemsPerSecond(phase))
+				.Key("peak_rss_mb"s).Value(static_cast<double>(phase.peak_rss) / (1 << 20))
+				.Key("allocations"s).Value(ToJsonCount(phase.allocations.allocations))
+				.Key("allocated_kb"s).Value(static_cast<double>(phase.allocations.bytes) / 1024);
+			if (settings_.perf_counters) {
+				report.Key("cycles"s).Value(static_cast<double>(phase.perf.cycles))
+					.Key("instructions"s).Value(static_cast<double>(phase.perf.instructions))
+					.Key("ipc"s).Value(GetRatio(phase.perf.instructions, phase.perf.cycles))
+					.Key("cache_miss_rate"s).Value(GetRatio(phase.perf.cache_misses, phase.perf.cache_references))
+					.Key("branch_miss_rate"s).Value(GetRatio(phase.perf.branch_misses, phase.perf.branches));
+			}
+			report.EndDict();
+		}
+		report.EndArray().Key("latency"s).StartDict();
+		for (const auto& [request_type, histogram] : GetLatencyHistograms()) {
+			report.Key(request_type).StartDict()
+				.Key("count"s).Value(ToJsonCount(histogram.GetCount()))
+				.Key("mean_us"s).Value(histogram.GetMean() / 1000.0);
+			for (const auto& percentile : LATENCY_PERCENTILES) {
+				report.Key(std::string(percentile.key)).Value(ToMicroseconds(histogram.GetValueAtPercentile(percentile.percentile)));
+			}
+			report.Key("max_us"s).Value(ToMicroseconds(histogram.GetMax())).EndDict();
+		}
+		report.EndDict().Key("memory"s).StartDict();
+		std::lock_guard guard(phases_mutex_);
+		for (const auto& [title, memory_report] : memory_usages_) {
+			report.Key(title).StartArray();
+			for (const auto& component : memory_report.components) {
+				report.StartDict()
+					.Key("name"s).Value(component.name)
+					.Key("elements"s).Value(ToJsonCount(component.elements))
+					.Key("kb"s).Value(static_cast<double>(component.bytes) / 1024)
+					.EndDict();
+			}
+			report.EndArray();
+		}
+		json::Print(json::Document{ report.EndDict().EndDict().Build() }, output);
+	}
+
+	void Profiler::PrintTrace(std::ostream& output) const {
+		// Трасса печатается потоком, а не через json::Builder: она бывает большой,
+		// а отметкам времени нужна точность до долей микросекунды на всём протяжении работы
+		output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["sv << std::fixed << std::setprecision(3);
+		bool is_first = true;
+		std::lock_guard guard(thread_shards_mutex_);
+		for (const auto& shard : thread_shards_) {
+			for (const TraceEvent& event : shard->trace_events) {
+				output << (is_first ? "\n"sv : ",\n"sv) << "{\"name\": "sv;
+				json::Print(json::Document{ json::Node{ event.name } }, output);
+				output << ", \"cat\": "sv;
+				json::Print(json::Document{ json::Node{ std::string(event.category) } }, output);
+				output << ", \"ph\": \"X\", \"ts\": "sv << std::chrono::duration<double, std::micro>(event.start).count()
+				       << ", \"dur\": "sv << std::chrono::duration<double, std::micro>(event.duration).count()
+				       << ", \"pid\": 1, \"tid\": "sv << shard->thread_index << '}';
+				is_first = false;
+			}
+		}
+		output << "\n]}\n"sv << std::defaultfloat;
+	}
+}
\ No newline at end of file
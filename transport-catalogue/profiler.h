@@ -0,0 +1,151 @@
+#pragma once
+
+#include "allocation_counter.h"
+#include "latency_histogram.h"
+#include "memory_usage.h"
+#include "perf_counters.h"
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace profiler {
+
+	// Пиковый объём резидентной памяти процесса в байтах
+	size_t GetPeakRss();
+
+	struct PhaseStatistics {
+		std::string name;
+		size_t calls = 0;
+		size_t items = 0;
+		std::chrono::steady_clock::duration duration{};
+		size_t peak_rss = 0;
+		// Выделения памяти и аппаратные счётчики потока, замерявшего фазу
+		AllocationStatistics allocations{};
+		PerfSample perf{};
+	};
+
+	struct ProfilerSettings {
+		// Сохранять интервалы фаз для PrintTrace
+		bool trace = false;
+		// Снимать аппаратные счётчики процессора в каждой фазе
+		bool perf_counters = false;
+	};
+
+	// Законченный интервал фазы для трассировки; время отсчитывается от создания профилировщика
+	struct TraceEvent {
+		std::string name;
+		std::string_view category;
+		std::chrono::steady_clock::duration start{};
+		std::chrono::steady_clock::duration duration{};
+	};
+
+	// Накапливает время, число обработанных элементов и пиковую память по фазам обработки.
+	// Повторные замеры фазы с тем же именем суммируются, порядок фаз в отчёте - порядок первого замера.
+	// Фазы можно замерять из нескольких потоков
+	class Profiler {
+	public:
+		// Замер фазы на время жизни объекта; при нулевом профилировщике ничего не делает.
+		// Имя фазы - name или "name.detail", если detail не пуст
+		class Phase {
+		public:
+			Phase(Profiler* profiler, std::string_view name, std::string_view detail = {}, size_t items = 1);
+			~Phase();
+
+			// Фаза "stat_request.<request_type>", длительность которой дополнительно попадает
+			// в гистограмму задержек этого типа запросов. Неизвестные типы учитываются как "unknown"
+			static Phase ForRequest(Profiler* profiler, std::string_view request_type);
+
+			Phase(const Phase&) = delete;
+			Phase& operator=(const Phase&) = delete;
+
+			void SetItems(size_t items);
+
+		private:
+			Profiler* profiler_;
+			std::string_view name_;
+			std::string_view detail_;
+			size_t items_;
+			bool record_latency_;
+			std::chrono::steady_clock::time_point start_;
+			AllocationStatistics start_allocations_;
+			const PerfCounters* perf_counters_ = nullptr;
+			PerfSample start_perf_;
+
+			Phase(Profiler* profiler, std::string_view name, std::string_view detail, size_t items, bool record_latency);
+		};
+
+		explicit Profiler(ProfilerSettings settings = {});
+
+		void AddPhase(std::string_view name, std::string_view detail, size_t items,
+		              std::chrono::steady_clock::duration duration, AllocationStatistics allocations = {},
+		              PerfSample perf = {});
+
+		std::vector<PhaseStatistics> GetPhases() const;
+
+		bool IsTraceEnabled() const;
+
+		// Счётчики вызывающего потока; nullptr, если они не включены или недоступны
+		const PerfCounters* GetThreadPerfCounters();
+
+		// Записывает интервал фазы в буфер трассировки вызывающего потока; name - строковый литерал,
+		// он же категория события
+		void RecordTraceEvent(std::string_view name, std::string_view detail,
+		                      std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration duration);
+
+		// Записывает задержку в гистограмму вызывающего потока без блокировок;
+		// блокировка берётся только при первой записи потока в этот профилировщик
+		void RecordLatency(std::string_view request_type, std::chrono::steady_clock::duration duration);
+
+		// Сливает гистограммы всех потоков; вызывается, когда записывающие потоки завершили работу
+		std::map<std::string, LatencyHistogram> GetLatencyHistograms() const;
+
+		// Сохраняет оценку памяти структуры для отчёта, например справочника после загрузки
+		void AddMemoryUsage(std::string title, memory_usage::Report report);
+
+		// Таблицы фаз, задержек запросов и памяти структур для чтения человеком
+		void PrintReport(std::ostream& output) const;
+
+		// Словарь JSON: phases - массив фаз (name, calls, items, time_ms, items_per_second, peak_rss_mb,
+		// allocations, allocated_kb, а со счётчиками процессора ещё cycles, instructions, ipc,
+		// cache_miss_rate, branch_miss_rate),
+		// latency - задержки по типам запросов (count, mean_us, p50_us, p90_us, p99_us, p99_9_us, max_us),
+		// memory - память структур по частям (name, elements, kb)
+		void PrintJsonReport(std::ostream& output) const;
+
+		// Трасса в формате Chrome trace event (chrome://tracing, Perfetto): интервалы всех фаз,
+		// tid - порядковый номер потока в профилировщике. Вызывается, когда записывающие потоки завершили работу
+		void PrintTrace(std::ostream& output) const;
+
+	private:
+		// Данные, которые поток пишет без блокировок
+		struct ThreadShard {
+			size_t thread_index = 0;
+			std::map<std::string, LatencyHistogram, std::less<>> latency_histograms;
+			std::vector<TraceEvent> trace_events;
+			std::unique_ptr<PerfCounters> perf_counters;
+		};
+
+		uint64_t profiler_id_;
+		ProfilerSettings settings_;
+		// Причина, по которой не удалось открыть счётчики в каком-либо потоке
+		std::string perf_error_;
+		std::chrono::steady_clock::time_point start_time_;
+		mutable std::mutex phases_mutex_;
+		std::vector<PhaseStatistics> phases_;
+		std::map<std::string, size_t, std::less<>> phases_indexes_;
+		std::vector<std::pair<std::string, memory_usage::Report>> memory_usages_;
+		mutable std::mutex thread_shards_mutex_;
+		std::vector<std::unique_ptr<ThreadShard>> thread_shards_;
+
+		ThreadShard& GetThreadShard();
+
+		void PrintPerfReport(std::ostream& output) const;
+	};
+}
\ No newline at end of file
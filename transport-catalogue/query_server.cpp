@@ -0,0 +1,196 @@
+#include "query_server.h"
+#include "json.h"
+#include "json_reader.h"
+
+#include <chrono>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+namespace query_server {
+
+	using namespace std::literals;
+
+	namespace {
+		json::Node CreateErrorNode(const json::Node& request, std::string error_message) {
+			json::Builder error_node;
+			error_node.StartDict();
+			if (request.IsMap() && request.AsMap().count("id"s) > 0 && request.AsMap().at("id"s).IsInt()) {
+				error_node.Key("request_id"s).Value(request.AsMap().at("id"s).AsInt());
+			}
+			error_node.Key("error_message"s).Value(std::move(error_message));
+			return error_node.EndDict().Build();
+		}
+
+		// Весь запрос разбирается до Apply: ответ с ошибкой всегда означает, что справочник не изменился
+		json::Node CreateUpdateNode(const json::Dict& data, catalogue_store::CatalogueStore& store) {
+			const int request_id = data.at("id"s).AsInt();
+			const catalogue_store::CatalogueUpdate update = json_reader::ParseCatalogueUpdate(data);
+			const uint64_t version = store.Apply(update);
+			return json::Builder{}.StartDict().Key("request_id"s).Value(request_id)
+				.Key("version"s).Value(static_cast<int>(version)).EndDict().Build();
+		}
+
+		// Положение кавычки, закрывающей строку JSON, которая открывается в request_line[begin]
+		size_t FindStringEnd(std::string_view request_line, size_t begin) {
+			for (size_t position = begin + 1; position < request_line.size(); ++position) {
+				if (request_line[position] == '\\') {
+					++position;
+				}
+				else if (request_line[position] == '"') {
+					return position;
+				}
+			}
+			return std::string_view::npos;
+		}
+
+		deadline::Deadline CreateDeadline(const json::Dict& data, deadline::Deadline::Clock::time_point received_at) {
+			if (data.count("deadline_ms"s) == 0) {
+				return {};
+			}
+			const int timeout = data.at("deadline_ms"s).AsInt();
+			if (timeout < 0) {
+				throw std::invalid_argument("deadline_ms must not be negative"s);
+			}
+			return deadline::Deadline(received_at + std::chrono::milliseconds(timeout));
+		}
+
+		json::Node CreateResponseNode(const json::Node& request,
+		                              catalogue_store::CatalogueStore& store,
+		                              const map_renderer::MapRender& map_renderer,
+		                              profiler::Profiler* profiler,
+		                              deadline::Deadline::Clock::time_point received_at) {
+			if (!request.IsMap() || request.AsMap().count("type"s) == 0 || !request.AsMap().at("type"s).IsString()) {
+				return CreateErrorNode(request, "invalid request"s);
+			}
+			const auto& data = request.AsMap();
+			auto phase = profiler::Profiler::Phase::ForRequest(profiler, data.at("type"s).AsString());
+			try {
+				// Запрос, срок которого истёк ещё в очереди, не начинается; Update после начала не прерывается
+				const deadline::Deadline deadline = CreateDeadline(data, received_at);
+				deadline.Check();
+				if (data.at("type"s).AsString() == "Update"s) {
+					return CreateUpdateNode(data, store);
+				}
+				// Запрос целиком отвечается по одной версии справочника, даже если тем временем вышла новая
+				const auto snapshot = store.GetSnapshot();
+				const request_handler::RequestHandler request_handler(snapshot->catalogue, map_renderer);
+				if (auto statistics = json_reader::CreateStatisticsNode(data, request_handler, snapshot->catalogue,
+				                                                                   deadline)) {
+					return *statistics;
+				}
+				return CreateErrorNode(request, "unknown request type"s);
+			}
+			catch (const deadline::DeadlineExceeded& error) {
+				return CreateErrorNode(request, error.what());
+			}
+			catch (const std::exception& error) {
+				return CreateErrorNode(request, "invalid request: "s + error.what());
+			}
+		}
+	}
+
+	RequestClass ClassifyRequestLine(std::string_view request_line) {
+		constexpr std::string_view whitespace = " \t\r\n"sv;
+		int depth = 0;
+		for (size_t position = 0; position < request_line.size(); ++position) {
+			const char symbol = request_line[position];
+			if (symbol == '{' || symbol == '[') {
+				++depth;
+				continue;
+			}
+			if (symbol == '}' || symbol == ']') {
+				--depth;
+				continue;
+			}
+			if (symbol != '"') {
+				continue;
+			}
+			const size_t key_end = FindStringEnd(request_line, position);
+			if (key_end == std::string_view::npos) {
+				break;
+			}
+			const std::string_view key = request_line.substr(position + 1, key_end - position - 1);
+			position = key_end;
+			// "type" может встретиться и как значение, поэтому за ключом должны идти двоеточие и строка
+			if (depth != 1 || key != "type"sv) {
+				continue;
+			}
+			size_t value_begin = request_line.find_first_not_of(whitespace, key_end + 1);
+			if (value_begin == std::string_view::npos || request_line[value_begin] != ':') {
+				continue;
+			}
+			value_begin = request_line.find_first_not_of(whitespace, value_begin + 1);
+			if (value_begin == std::string_view::npos || request_line[value_begin] != '"') {
+				continue;
+			}
+			const size_t value_end = FindStringEnd(request_line, value_begin);
+			if (value_end == std::string_view::npos) {
+				break;
+			}
+			const std::string_view type = request_line.substr(value_begin + 1, value_end - value_begin - 1);
+			if (type == "Update"sv) {
+				return RequestClass::UPDATE;
+			}
+			return type == "Map"sv ? RequestClass::HEAVY : RequestClass::LOOKUP;
+		}
+		return RequestClass::LOOKUP;
+	}
+
+	json::Document ParseRequestLine(std::string_view request_line) {
+		std::istringstream request_stream{ std::string(request_line) };
+		return json::Load(request_stream);
+	}
+
+	json::Node CreateParsingErrorResponse(const json::ParsingError& error) {
+		return CreateErrorNode(json::Node{}, "invalid json: "s + error.what());
+	}
+
+	json::Node CreateResponse(const json::Node& request,
+	                          catalogue_store::CatalogueStore& store,
+	                          const map_renderer::MapRender& map_renderer,
+	                          profiler::Profiler* profiler,
+	                          deadline::Deadline::Clock::time_point received_at) {
+		return CreateResponseNode(request, store, map_renderer, profiler, received_at);
+	}
+
+	std::string PrintResponse(json::Node response) {
+		std::ostringstream response_stream;
+		json::PrintCompact(json::Document{ std::move(response) }, response_stream);
+		return response_stream.str();
+	}
+
+	std::string ProcessRequestLine(std::string_view request_line,
+	                               catalogue_store::CatalogueStore& store,
+	                               const map_renderer::MapRender& map_renderer,
+	                               profiler::Profiler* profiler,
+	                               deadline::Deadline::Clock::time_point received_at) {
+		json::Node response;
+		try {
+			const json::Document request = ParseRequestLine(request_line);
+			response = CreateResponse(request.GetRoot(), store, map_renderer, profiler, received_at);
+		}
+		catch (const json::ParsingError& error) {
+			response = CreateParsingErrorResponse(error);
+		}
+		return PrintResponse(std::move(response));
+	}
+
+	void ServeStream(std::istream& input, std::ostream& output,
+	                 catalogue_store::CatalogueStore& store,
+	                 const map_renderer::MapRender& map_renderer,
+	                 profiler::Profiler* profiler) {
+		std::string request_line;
+		while (std::getline(input, request_line)) {
+			if (request_line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+				continue;
+			}
+			output << ProcessRequestLine(request_line, store, map_renderer, profiler) << '\n';
+			// Под нагрузкой ответы уходят пачками, а клиент, ждущий ответа, получает его сразу
+			if (input.rdbuf()->in_avail() <= 0) {
+				output.flush();
+			}
+		}
+		output.flush();
+	}
+}
\ No newline at end of file
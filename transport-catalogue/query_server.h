@@ -0,0 +1,63 @@
+#pragma once
+
+#include "catalogue_store.h"
+#include "deadline.h"
+#include "json.h"
+#include "map_renderer.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace query_server {
+
+	// Отвечает на запрос в формате элемента stat_requests, записанный одним JSON-объектом,
+	// по текущей версии справочника из store. Запрос Update применяет изменения к справочнику
+	// (json_reader::ParseCatalogueUpdate) и возвращает номер новой версии в поле version.
+	// Ответ - JSON-объект в одну строку без перевода строки в конце; на неразборчивый запрос
+	// или запрос неизвестного типа возвращается объект с error_message.
+	// Запрос с полем deadline_ms должен получить ответ за столько миллисекунд от received_at, включая ожидание
+	// в очереди сервера; иначе он не начинается или прерывается и получает error_message "deadline exceeded"
+	std::string ProcessRequestLine(std::string_view request_line,
+	                               catalogue_store::CatalogueStore& store,
+	                               const map_renderer::MapRender& map_renderer,
+	                               profiler::Profiler* profiler = nullptr,
+	                               deadline::Deadline::Clock::time_point received_at = deadline::Deadline::Clock::now());
+
+	// Класс запроса для планирования: тяжёлые запросы (Map, Update) отвечаются на порядки дольше,
+	// чем поиск остановки или маршрута. Update выделен в свой класс, потому что меняет справочник
+	// и не может исполняться вперемешку с соседними запросами того же клиента
+	enum class RequestClass {
+		LOOKUP,
+		HEAVY,
+		UPDATE,
+	};
+
+	// Определяет класс по полю type внешнего объекта строки запроса, не разбирая её целиком:
+	// строки и вложенные объекты и массивы пропускаются, так что их поля type не учитываются.
+	// Строка без распознаваемого type считается LOOKUP: ответ на неё - дешёвое сообщение об ошибке
+	RequestClass ClassifyRequestLine(std::string_view request_line);
+
+	// Стадии ProcessRequestLine по отдельности, для конвейера request_pipeline.
+	// ParseRequestLine бросает json::ParsingError на неразборчивую строку, и ответом на неё
+	// служит CreateParsingErrorResponse; CreateResponse и PrintResponse исключений не бросают
+	json::Document ParseRequestLine(std::string_view request_line);
+
+	json::Node CreateParsingErrorResponse(const json::ParsingError& error);
+
+	json::Node CreateResponse(const json::Node& request,
+	                          catalogue_store::CatalogueStore& store,
+	                          const map_renderer::MapRender& map_renderer,
+	                          profiler::Profiler* profiler = nullptr,
+	                          deadline::Deadline::Clock::time_point received_at = deadline::Deadline::Clock::now());
+
+	std::string PrintResponse(json::Node response);
+
+	// Читает запросы по одному в строке до конца потока и пишет по строке ответа на каждый.
+	// Пустые строки пропускаются; вывод сбрасывается, когда во входном буфере не осталось запросов
+	void ServeStream(std::istream& input, std::ostream& output,
+	                 catalogue_store::CatalogueStore& store,
+	                 const map_renderer::MapRender& map_renderer,
+	                 profiler::Profiler* profiler = nullptr);
+}
\ No newline at end of file
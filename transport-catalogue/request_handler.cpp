@@ -9,7 +9,7 @@
 
 namespace request_handler {
 
-    svg::Document RequestHandler::RenderMap() const {        
+    svg::Document RequestHandler::RenderMap(const deadline::Deadline& deadline) const {        
         std::map<std::string_view, const domain::Bus*> buses;
         for (const auto& [bus_name, bus_detail] : db_.GetBuses()) {
             buses.try_emplace(bus_name, bus_detail);
@@ -22,7 +22,7 @@ namespace request_handler {
             }
         }
 
-        svg::Document output_map = map_renderer_.CreateMap(buses, stops);
+        svg::Document output_map = map_renderer_.CreateMap(buses, stops, deadline);
 
         return output_map;
     }
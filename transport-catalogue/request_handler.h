@@ -1,5 +1,6 @@
 #pragma once
 
+#include "deadline.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 
@@ -21,8 +22,9 @@ namespace request_handler {
         {
         }
          
-        // Возвращает svg-документ, для отображения карты маршрутов
-        svg::Document RenderMap() const;
+        // Возвращает svg-документ, для отображения карты маршрутов; по истечении deadline
+        // бросает deadline::DeadlineExceeded
+        svg::Document RenderMap(const deadline::Deadline& deadline = {}) const;
 
     private:
         // RequestHandler использует агрегацию объектов "Транспортный Справочник" и "Визуализатор Карты"
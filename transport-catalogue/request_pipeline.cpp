@@ -0,0 +1,346 @@
+#include "request_pipeline.h"
+
+#ifdef REQUEST_PIPELINE_AVAILABLE
+
+#include "json.h"
+#include "query_server.h"
+
+#include <atomic>
+#include <latch>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace request_pipeline {
+
+	using namespace std::literals;
+
+	Executor::Executor(size_t threads_count) {
+		threads_count = std::max<size_t>(threads_count, 1);
+		threads_.reserve(threads_count);
+		for (size_t i = 0; i < threads_count; ++i) {
+			threads_.emplace_back(&Executor::WorkLoop, this);
+		}
+	}
+
+	Executor::~Executor() {
+		{
+			std::lock_guard guard(mutex_);
+			is_stopping_ = true;
+		}
+		has_work_.notify_all();
+		for (std::thread& thread : threads_) {
+			thread.join();
+		}
+	}
+
+	void Executor::Post(std::coroutine_handle<> handle) {
+		{
+			std::lock_guard guard(mutex_);
+			handles_.push_back(handle);
+		}
+		has_work_.notify_one();
+	}
+
+	void Executor::WorkLoop() {
+		while (true) {
+			std::coroutine_handle<> handle;
+			{
+				std::unique_lock lock(mutex_);
+				has_work_.wait(lock, [this] { return is_stopping_ || !handles_.empty(); });
+				if (handles_.empty()) {
+					return;
+				}
+				handle = handles_.front();
+				handles_.pop_front();
+			}
+			handle.resume();
+		}
+	}
+
+	namespace {
+		struct RequestLine {
+			size_t index = 0;
+			std::string line;
+			deadline::Deadline::Clock::time_point received_at;
+		};
+
+		// Разобранный запрос или сразу ответ, если строку не удалось разобрать
+		struct ParsedRequest {
+			size_t index = 0;
+			std::optional<json::Document> request;
+			json::Node response;
+			deadline::Deadline::Clock::time_point received_at;
+		};
+
+		struct Response {
+			size_t index = 0;
+			json::Node response;
+		};
+
+		struct PrintedResponse {
+			size_t index = 0;
+			std::string text;
+		};
+
+		// Число запросов в конвейере: читатель входа занимает место, стадия записи освобождает
+		class InFlightLimit {
+		public:
+			explicit InFlightLimit(size_t limit)
+				:available_(std::max<size_t>(limit, 1))
+			{
+			}
+
+			void Acquire() {
+				std::unique_lock lock(mutex_);
+				released_.wait(lock, [this] { return available_ > 0; });
+				--available_;
+			}
+
+			void Release() {
+				{
+					std::lock_guard guard(mutex_);
+					++available_;
+				}
+				released_.notify_one();
+			}
+
+		private:
+			std::mutex mutex_;
+			std::condition_variable released_;
+			size_t available_;
+		};
+
+		bool IsUpdateRequest(const ParsedRequest& parsed) {
+			if (!parsed.request || !parsed.request->GetRoot().IsMap()) {
+				return false;
+			}
+			const json::Dict& data = parsed.request->GetRoot().AsMap();
+			const auto type = data.find("type"s);
+			return type != data.end() && type->second.IsString() && type->second.AsString() == "Update"sv;
+		}
+
+		// Порядок исполнения запросов относительно Update, как в последовательном режиме serve:
+		// запросы входят по порядку номеров, Update начинается, когда закончились все предыдущие запросы,
+		// а следующие за ним начинаются после него. Запросы между двумя Update исполняются одновременно.
+		// Очереди конвейера сохраняют порядок, поэтому запрос, которого ждут, уже получен одним из исполнителей.
+		// Ожидающая сопрограмма приостанавливается, а не блокирует поток пула: поток может понадобиться
+		// как раз тому запросу, которого она ждёт
+		class UpdateBarrier {
+		public:
+			explicit UpdateBarrier(Executor& executor)
+				:executor_(executor)
+			{
+			}
+
+			// co_await barrier.Enter(index, is_update) продолжается, когда запросу index можно исполняться
+			auto Enter(size_t index, bool is_update) {
+				return EnterAwaiter{ *this, index, is_update };
+			}
+
+			// Запрос закончил исполнение; его ответ может ещё ждать записи
+			void Leave(bool is_update) {
+				std::vector<std::coroutine_handle<>> admitted;
+				{
+					std::lock_guard guard(mutex_);
+					if (is_update) {
+						is_update_running_ = false;
+					}
+					else {
+						--running_count_;
+					}
+					AdmitLocked(admitted);
+				}
+				for (std::coroutine_handle<> handle : admitted) {
+					executor_.Post(handle);
+				}
+			}
+
+		private:
+			struct EnterAwaiter {
+				UpdateBarrier& barrier;
+				size_t index;
+				bool is_update;
+				std::coroutine_handle<> handle{};
+
+				bool await_ready() const noexcept {
+					return false;
+				}
+
+				bool await_suspend(std::coroutine_handle<> awaiting) {
+					handle = awaiting;
+					// После разблокировки сопрограмму может продолжить другой поток, и этот объект будет разрушен,
+					// поэтому дальше используются только локальные переменные
+					UpdateBarrier& owner = barrier;
+					std::vector<std::coroutine_handle<>> admitted;
+					{
+						std::lock_guard guard(owner.mutex_);
+						owner.waiting_.emplace(index, this);
+						owner.AdmitLocked(admitted);
+					}
+					// Допущенный сразу запрос продолжается без приостановки, остальных продолжает пул
+					bool is_self_admitted = false;
+					for (std::coroutine_handle<> admitted_handle : admitted) {
+						if (admitted_handle == awaiting) {
+							is_self_admitted = true;
+						}
+						else {
+							owner.executor_.Post(admitted_handle);
+						}
+					}
+					return !is_self_admitted;
+				}
+
+				void await_resume() const noexcept {
+				}
+			};
+
+			Executor& executor_;
+			std::mutex mutex_;
+			std::map<size_t, EnterAwaiter*> waiting_;
+			// Номер запроса, который войдёт следующим
+			size_t next_index_ = 0;
+			size_t running_count_ = 0;
+			bool is_update_running_ = false;
+
+			void AdmitLocked(std::vector<std::coroutine_handle<>>& admitted) {
+				while (!waiting_.empty() && waiting_.begin()->first == next_index_ && !is_update_running_) {
+					EnterAwaiter* waiter = waiting_.begin()->second;
+					if (waiter->is_update) {
+						if (running_count_ > 0) {
+							return;
+						}
+						is_update_running_ = true;
+					}
+					else {
+						++running_count_;
+					}
+					waiting_.erase(waiting_.begin());
+					++next_index_;
+					admitted.push_back(waiter->handle);
+				}
+			}
+		};
+
+		// Каждая стадия закрывает свою выходную очередь, когда закончилась входная,
+		// и последним действием отмечается в finished
+		DetachedTask ParseRequests(Executor& executor, Channel<RequestLine>& lines,
+		                           Channel<ParsedRequest>& requests, std::latch& finished) {
+			co_await executor.Schedule();
+			while (auto request_line = co_await lines.Receive()) {
+				ParsedRequest parsed{ request_line->index, std::nullopt, json::Node{}, request_line->received_at };
+				try {
+					parsed.request = query_server::ParseRequestLine(request_line->line);
+				}
+				catch (const json::ParsingError& error) {
+					parsed.response = query_server::CreateParsingErrorResponse(error);
+				}
+				co_await requests.Send(std::move(parsed));
+			}
+			requests.Close();
+			finished.count_down();
+		}
+
+		DetachedTask ExecuteRequests(Executor& executor, Channel<ParsedRequest>& requests,
+		                             Channel<Response>& responses, std::atomic<size_t>& running_executors,
+		                             UpdateBarrier& update_barrier, catalogue_store::CatalogueStore& store,
+		                             const map_renderer::MapRender& map_renderer,
+		                             profiler::Profiler* profiler, std::latch& finished) {
+			co_await executor.Schedule();
+			while (auto parsed = co_await requests.Receive()) {
+				const bool is_update = IsUpdateRequest(*parsed);
+				co_await update_barrier.Enter(parsed->index, is_update);
+				Response response{ parsed->index, std::move(parsed->response) };
+				if (parsed->request) {
+					response.response = query_server::CreateResponse(parsed->request->GetRoot(), store,
+					                                                  map_renderer, profiler, parsed->received_at);
+				}
+				update_barrier.Leave(is_update);
+				co_await responses.Send(std::move(response));
+			}
+			if (running_executors.fetch_sub(1) == 1) {
+				responses.Close();
+			}
+			finished.count_down();
+		}
+
+		DetachedTask PrintResponses(Executor& executor, Channel<Response>& responses,
+		                            Channel<PrintedResponse>& printed, std::latch& finished) {
+			co_await executor.Schedule();
+			while (auto response = co_await responses.Receive()) {
+				PrintedResponse printed_response{ response->index, query_server::PrintResponse(std::move(response->response)) };
+				co_await printed.Send(std::move(printed_response));
+			}
+			printed.Close();
+			finished.count_down();
+		}
+
+		DetachedTask WriteResponses(Executor& executor, Channel<PrintedResponse>& printed, std::ostream& output,
+		                            InFlightLimit& in_flight, std::latch& finished) {
+			co_await executor.Schedule();
+			// Ответы, обогнавшие предыдущие запросы, ждут здесь своей очереди
+			std::map<size_t, std::string> pending;
+			size_t next_index = 0;
+			while (auto response = co_await printed.Receive()) {
+				pending.emplace(response->index, std::move(response->text));
+				while (!pending.empty() && pending.begin()->first == next_index) {
+					output << pending.begin()->second << '\n';
+					pending.erase(pending.begin());
+					++next_index;
+					in_flight.Release();
+				}
+				// Под нагрузкой ответы уходят пачками, а клиент, ждущий ответа, получает его сразу
+				if (printed.IsEmpty()) {
+					output.flush();
+				}
+			}
+			output.flush();
+			finished.count_down();
+		}
+	}
+
+	void ServeStream(std::istream& input, std::ostream& output,
+	                 catalogue_store::CatalogueStore& store,
+	                 const map_renderer::MapRender& map_renderer,
+	                 PipelineSettings settings,
+	                 profiler::Profiler* profiler) {
+		const size_t executors_count = std::max<size_t>(settings.workers_count, 1);
+		auto executor_holder = std::make_unique<Executor>(executors_count);
+		Executor& executor = *executor_holder;
+		Channel<RequestLine> lines(executor, settings.queue_capacity);
+		Channel<ParsedRequest> requests(executor, settings.queue_capacity);
+		Channel<Response> responses(executor, settings.queue_capacity);
+		Channel<PrintedResponse> printed(executor, settings.queue_capacity);
+		InFlightLimit in_flight(settings.max_in_flight);
+		UpdateBarrier update_barrier(executor);
+		std::atomic<size_t> running_executors{ executors_count };
+		std::latch finished(static_cast<std::ptrdiff_t>(executors_count + 3));
+
+		ParseRequests(executor, lines, requests, finished);
+		for (size_t i = 0; i < executors_count; ++i) {
+			ExecuteRequests(executor, requests, responses, running_executors, update_barrier, store, map_renderer,
+			                profiler, finished);
+		}
+		PrintResponses(executor, responses, printed, finished);
+		WriteResponses(executor, printed, output, in_flight, finished);
+
+		std::string request_line;
+		size_t index = 0;
+		while (std::getline(input, request_line)) {
+			if (request_line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+				continue;
+			}
+			const auto received_at = deadline::Deadline::Clock::now();
+			in_flight.Acquire();
+			lines.SendBlocking({ index++, std::move(request_line), received_at });
+		}
+		lines.Close();
+		finished.wait();
+		// Пул останавливается раньше очередей и finished: стадии могут ещё дорабатывать после отметки
+		executor_holder.reset();
+	}
+}
+
+#endif
@@ -0,0 +1,257 @@
+#pragma once
+
+// Конвейер на сопрограммах C++20; при сборке по более старому стандарту модуль пуст
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#define REQUEST_PIPELINE_AVAILABLE 1
+
+#include "catalogue_store.h"
+#include "map_renderer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace request_pipeline {
+
+	// Пул потоков, который продолжает приостановленные сопрограммы всех стадий
+	class Executor {
+	public:
+		explicit Executor(size_t threads_count);
+
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+
+		// Дожидается продолжения всех уже поставленных сопрограмм
+		~Executor();
+
+		void Post(std::coroutine_handle<> handle);
+
+		// co_await executor.Schedule() переносит сопрограмму в пул
+		auto Schedule() {
+			struct Awaiter {
+				Executor& executor;
+
+				bool await_ready() const noexcept {
+					return false;
+				}
+
+				void await_suspend(std::coroutine_handle<> handle) {
+					executor.Post(handle);
+				}
+
+				void await_resume() const noexcept {
+				}
+			};
+			return Awaiter{ *this };
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable has_work_;
+		std::deque<std::coroutine_handle<>> handles_;
+		bool is_stopping_ = false;
+		std::vector<std::thread> threads_;
+
+		void WorkLoop();
+	};
+
+	// Сопрограмма, которую никто не ждёт: начинается сразу и освобождает себя по завершении.
+	// Стадии сами превращают ошибки запросов в ответы, поэтому вылетевшее исключение - ошибка программы
+	struct DetachedTask {
+		struct promise_type {
+			DetachedTask get_return_object() noexcept {
+				return {};
+			}
+
+			std::suspend_never initial_suspend() noexcept {
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept {
+				return {};
+			}
+
+			void return_void() noexcept {
+			}
+
+			void unhandled_exception() noexcept {
+				std::terminate();
+			}
+		};
+	};
+
+	// Ограниченная очередь между стадиями. Отправитель приостанавливается, пока в очереди нет места,
+	// получатель - пока в ней нет значений; приостановленные сопрограммы продолжает Executor.
+	// Поток вне пула отправляет значения через SendBlocking и ждёт места, блокируясь
+	template <typename T>
+	class Channel {
+	public:
+		Channel(Executor& executor, size_t capacity)
+			:executor_(executor), capacity_(std::max<size_t>(capacity, 1))
+		{
+		}
+
+		auto Send(T value) {
+			return SendAwaiter{ *this, std::move(value) };
+		}
+
+		void SendBlocking(T value) {
+			std::unique_lock lock(mutex_);
+			space_available_.wait(lock, [this] { return values_.size() < capacity_; });
+			// Пока отправитель ждал места, получатель мог разобрать очередь и встать в ожидание:
+			// значение в очереди он бы не заметил, а следующее получил бы раньше этого
+			if (HandOverLocked(value)) {
+				return;
+			}
+			values_.push_back(std::move(value));
+		}
+
+		// co_await channel.Receive() возвращает std::nullopt, когда канал закрыт и опустел
+		auto Receive() {
+			return ReceiveAwaiter{ *this };
+		}
+
+		// Больше значений не будет; ждущие получатели продолжаются с std::nullopt
+		void Close() {
+			std::deque<ReceiveAwaiter*> receivers;
+			{
+				std::lock_guard guard(mutex_);
+				is_closed_ = true;
+				receivers.swap(receivers_);
+			}
+			for (ReceiveAwaiter* receiver : receivers) {
+				executor_.Post(receiver->handle);
+			}
+		}
+
+		bool IsEmpty() const {
+			std::lock_guard guard(mutex_);
+			return values_.empty();
+		}
+
+	private:
+		struct SendAwaiter {
+			Channel& channel;
+			T value;
+			std::coroutine_handle<> handle{};
+
+			bool await_ready() const noexcept {
+				return false;
+			}
+
+			bool await_suspend(std::coroutine_handle<> awaiting) {
+				std::lock_guard guard(channel.mutex_);
+				if (channel.HandOverLocked(value)) {
+					return false;
+				}
+				if (channel.values_.size() < channel.capacity_) {
+					channel.values_.push_back(std::move(value));
+					return false;
+				}
+				handle = awaiting;
+				channel.senders_.push_back(this);
+				return true;
+			}
+
+			void await_resume() const noexcept {
+			}
+		};
+
+		struct ReceiveAwaiter {
+			Channel& channel;
+			std::optional<T> value{};
+			std::coroutine_handle<> handle{};
+
+			bool await_ready() const noexcept {
+				return false;
+			}
+
+			bool await_suspend(std::coroutine_handle<> awaiting) {
+				std::lock_guard guard(channel.mutex_);
+				if (!channel.values_.empty()) {
+					value = std::move(channel.values_.front());
+					channel.values_.pop_front();
+					channel.RefillLocked();
+					return false;
+				}
+				if (channel.is_closed_) {
+					return false;
+				}
+				handle = awaiting;
+				channel.receivers_.push_back(this);
+				return true;
+			}
+
+			std::optional<T> await_resume() {
+				return std::move(value);
+			}
+		};
+
+		Executor& executor_;
+		const size_t capacity_;
+		mutable std::mutex mutex_;
+		std::deque<T> values_;
+		std::deque<ReceiveAwaiter*> receivers_;
+		std::deque<SendAwaiter*> senders_;
+		std::condition_variable space_available_;
+		bool is_closed_ = false;
+
+		// Отдаёт значение ждущему получателю, если такой есть
+		bool HandOverLocked(T& value) {
+			if (receivers_.empty()) {
+				return false;
+			}
+			ReceiveAwaiter* receiver = receivers_.front();
+			receivers_.pop_front();
+			receiver->value = std::move(value);
+			executor_.Post(receiver->handle);
+			return true;
+		}
+
+		// После освобождения места забирает значение у ждущего отправителя или будит блокирующего
+		void RefillLocked() {
+			if (!senders_.empty()) {
+				SendAwaiter* sender = senders_.front();
+				senders_.pop_front();
+				values_.push_back(std::move(sender->value));
+				executor_.Post(sender->handle);
+				return;
+			}
+			space_available_.notify_one();
+		}
+	};
+
+	struct PipelineSettings {
+		// Потоки пула и число одновременно исполняемых запросов
+		size_t workers_count = std::max(std::thread::hardware_concurrency(), 1u);
+		// Ёмкость очереди между соседними стадиями
+		size_t queue_capacity = 16;
+		// Запросы, прочитанные, но ещё не записанные; при исчерпании чтение входа ждёт
+		size_t max_in_flight = 64;
+	};
+
+	// То же, что query_server::ServeStream, но запросы проходят стадии разбор → ответ → печать → запись,
+	// каждая из которых - сопрограмма на общем пуле Executor, связанная с соседними ограниченными очередями.
+	// Ответ на запрос исполняют workers_count сопрограмм, так что дорогие запросы Map не задерживают
+	// разбор и печать остальных, а ответы пишутся в порядке запросов. Update исполняется в одиночку:
+	// после всех предыдущих запросов и до всех следующих, поэтому ответы совпадают с последовательным serve.
+	// Поток, вызвавший функцию, читает input и перестаёт читать, когда в конвейере max_in_flight запросов,
+	// поэтому память под запросы ограничена
+	void ServeStream(std::istream& input, std::ostream& output,
+	                 catalogue_store::CatalogueStore& store,
+	                 const map_renderer::MapRender& map_renderer,
+	                 PipelineSettings settings = {},
+	                 profiler::Profiler* profiler = nullptr);
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "search_index.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace search_index {
+
+	namespace {
+		// Длина в байтах символа UTF-8, который начинается в text[position]
+		size_t GetSymbolSize(std::string_view text, size_t position) {
+			const auto lead = static_cast<unsigned char>(text[position]);
+			size_t size = 1;
+			if ((lead & 0xE0) == 0xC0) {
+				size = 2;
+			}
+			else if ((lead & 0xF0) == 0xE0) {
+				size = 3;
+			}
+			else if ((lead & 0xF8) == 0xF0) {
+				size = 4;
+			}
+			if (position + size > text.size()) {
+				return 1;
+			}
+			for (size_t i = 1; i < size; ++i) {
+				if ((static_cast<unsigned char>(text[position + i]) & 0xC0) != 0x80) {
+					return 1;
+				}
+			}
+			return size;
+		}
+
+		// Читает символ и сдвигает position. Символы только сравниваются на равенство,
+		// поэтому вместо кодовой точки возвращаются упакованные байты последовательности
+		uint32_t ReadSymbol(std::string_view text, size_t& position) {
+			const size_t size = GetSymbolSize(text, position);
+			uint32_t symbol = 0;
+			for (size_t i = 0; i < size; ++i) {
+				symbol = (symbol << 8) | static_cast<unsigned char>(text[position + i]);
+			}
+			position += size;
+			return symbol;
+		}
+
+		// Совпадают ли у названий символы, начинающиеся в position
+		bool HasSameSymbol(std::string_view lhs, std::string_view rhs, size_t position) {
+			if (position >= lhs.size() || position >= rhs.size()) {
+				return false;
+			}
+			const size_t size = GetSymbolSize(lhs, position);
+			return size == GetSymbolSize(rhs, position) && lhs.substr(position, size) == rhs.substr(position, size);
+		}
+	}
+
+	NameIndex::NameIndex(std::vector<NameEntry> entries)
+		:entries_(std::move(entries))
+	{
+		std::sort(entries_.begin(), entries_.end(), [](const NameEntry& lhs, const NameEntry& rhs) {
+			return std::tie(lhs.name, lhs.kind) < std::tie(rhs.name, rhs.kind);
+		});
+		nodes_.emplace_back();
+		BuildNode(0, 0, static_cast<uint32_t>(entries_.size()), 0);
+	}
+
+	void NameIndex::BuildNode(uint32_t node_index, uint32_t begin, uint32_t end, size_t depth) {
+		uint32_t terminal_end = begin;
+		while (terminal_end < end && entries_[terminal_end].name.size() == depth) {
+			++terminal_end;
+		}
+		nodes_[node_index].entries_begin = begin;
+		nodes_[node_index].terminal_end = terminal_end;
+		nodes_[node_index].subtree_end = end;
+
+		// Группы названий с общим следующим символом становятся детьми узла; названия упорядочены
+		// по байтам, а UTF-8 сохраняет этот порядок, поэтому каждая группа - непрерывный диапазон
+		std::vector<std::pair<uint32_t, uint32_t>> groups;
+		for (uint32_t group_begin = terminal_end; group_begin < end;) {
+			uint32_t group_end = group_begin + 1;
+			while (group_end < end && HasSameSymbol(entries_[group_end].name, entries_[group_begin].name, depth)) {
+				++group_end;
+			}
+			groups.emplace_back(group_begin, group_end);
+			group_begin = group_end;
+		}
+
+		const uint32_t first_child = static_cast<uint32_t>(nodes_.size());
+		nodes_[node_index].first_child = first_child;
+		nodes_[node_index].children_count = static_cast<uint32_t>(groups.size());
+		nodes_.resize(nodes_.size() + groups.size());
+
+		for (size_t i = 0; i < groups.size(); ++i) {
+			const auto [group_begin, group_end] = groups[i];
+			// Общий префикс группы равен общему префиксу её первого и последнего названий
+			const std::string_view first_name = entries_[group_begin].name;
+			const std::string_view last_name = entries_[group_end - 1].name;
+			size_t child_depth = depth + GetSymbolSize(first_name, depth);
+			while (HasSameSymbol(first_name, last_name, child_depth)) {
+				child_depth += GetSymbolSize(first_name, child_depth);
+			}
+			const uint32_t child_index = first_child + static_cast<uint32_t>(i);
+			nodes_[child_index].label = first_name.substr(depth, child_depth - depth);
+			BuildNode(child_index, group_begin, group_end, child_depth);
+		}
+	}
+
+	void NameIndex::CheckNodeEnd(const Node& node, size_t depth, SearchContext& context) const {
+		const size_t row_size = context.query.size() + 1;
+		const int distance = context.rows[depth * row_size + context.query.size()];
+		if (distance > context.max_errors) {
+			return;
+		}
+		if (context.is_prefix) {
+			context.matched_ranges.push_back({ node.entries_begin, node.subtree_end, distance });
+		}
+		else if (node.entries_begin != node.terminal_end) {
+			context.matched_ranges.push_back({ node.entries_begin, node.terminal_end, distance });
+		}
+	}
+
+	void NameIndex::SearchChildren(const Node& node, size_t depth, SearchContext& context) const {
+		const std::vector<uint32_t>& query = context.query;
+		const size_t row_size = query.size() + 1;
+		for (uint32_t child_index = node.first_child; child_index < node.first_child + node.children_count; ++child_index) {
+			const Node& child = nodes_[child_index];
+			size_t child_depth = depth;
+			bool is_pruned = false;
+			for (size_t label_position = 0; label_position < child.label.size();) {
+				const uint32_t symbol = ReadSymbol(child.label, label_position);
+				if (context.rows.size() < (child_depth + 2) * row_size) {
+					context.rows.resize((child_depth + 2) * row_size);
+				}
+				const int* previous_row = context.rows.data() + child_depth * row_size;
+				int* current_row = context.rows.data() + (child_depth + 1) * row_size;
+				current_row[0] = previous_row[0] + 1;
+				int row_minimum = current_row[0];
+				for (size_t i = 1; i < row_size; ++i) {
+					const int substitution = previous_row[i - 1] + (query[i - 1] == symbol ? 0 : 1);
+					current_row[i] = std::min({ previous_row[i] + 1, current_row[i - 1] + 1, substitution });
+					row_minimum = std::min(row_minimum, current_row[i]);
+				}
+				++child_depth;
+				// В префиксном режиме совпадение внутри метки распространяется на всё поддерево
+				if (context.is_prefix && label_position < child.label.size()
+					&& current_row[query.size()] <= context.max_errors) {
+					context.matched_ranges.push_back({ child.entries_begin, child.subtree_end, current_row[query.size()] });
+				}
+				if (row_minimum > context.max_errors) {
+					is_pruned = true;
+					break;
+				}
+			}
+			if (!is_pruned) {
+				CheckNodeEnd(child, child_depth, context);
+				SearchChildren(child, child_depth, context);
+			}
+		}
+	}
+
+	std::vector<SearchResult> NameIndex::Search(std::string_view query, int max_errors,
+	                                            bool is_prefix, size_t limit) const {
+		if (limit == 0 || entries_.empty()) {
+			return {};
+		}
+
+		// Поиск в глубину по дереву с построчным вычислением расстояния Левенштейна по символам
+		std::vector<uint32_t> query_symbols;
+		for (size_t position = 0; position < query.size();) {
+			query_symbols.push_back(ReadSymbol(query, position));
+		}
+		SearchContext context{ std::move(query_symbols), max_errors, is_prefix, {}, {} };
+		context.rows.resize(context.query.size() + 1);
+		for (size_t i = 0; i < context.rows.size(); ++i) {
+			context.rows[i] = static_cast<int>(i);
+		}
+		CheckNodeEnd(nodes_[0], 0, context);
+		SearchChildren(nodes_[0], 0, context);
+		std::vector<MatchedRange>& matched_ranges = context.matched_ranges;
+
+		// Диапазоны вложены друг в друга или не пересекаются; лучшие названия выбираются
+		// по возрастанию числа правок, внутри одного числа правок - в лексикографическом порядке
+		std::sort(matched_ranges.begin(), matched_ranges.end(), [](const MatchedRange& lhs, const MatchedRange& rhs) {
+			return std::tie(lhs.distance, lhs.begin) < std::tie(rhs.distance, rhs.begin);
+		});
+		std::vector<uint32_t> taken_entries;
+		std::vector<SearchResult> result;
+		for (size_t range_begin = 0; range_begin < matched_ranges.size() && result.size() < limit;) {
+			const int distance = matched_ranges[range_begin].distance;
+			const size_t remaining_count = limit - result.size();
+			size_t range_end = range_begin;
+			std::vector<uint32_t> candidates;
+			for (; range_end < matched_ranges.size() && matched_ranges[range_end].distance == distance; ++range_end) {
+				const MatchedRange& range = matched_ranges[range_end];
+				size_t taken_from_range = 0;
+				for (uint32_t entry = range.begin; entry < range.end && taken_from_range < remaining_count; ++entry) {
+					if (std::find(taken_entries.begin(), taken_entries.end(), entry) == taken_entries.end()) {
+						candidates.push_back(entry);
+						++taken_from_range;
+					}
+				}
+			}
+			std::sort(candidates.begin(), candidates.end());
+			candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+			for (uint32_t entry : candidates) {
+				if (result.size() == limit) {
+					break;
+				}
+				taken_entries.push_back(entry);
+				result.push_back({ entries_[entry].name, entries_[entry].kind, distance });
+			}
+			range_begin = range_end;
+		}
+		return result;
+	}
+
+	size_t NameIndex::MemoryUsage() const {
+		return memory_usage::GetHeapBytes(entries_) + memory_usage::GetHeapBytes(nodes_);
+	}
+}
\ No newline at end of file
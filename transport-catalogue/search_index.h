@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace search_index {
+
+	enum class NameKind {
+		STOP,
+		BUS
+	};
+
+	struct NameEntry {
+		std::string_view name;
+		NameKind kind;
+	};
+
+	struct SearchResult {
+		std::string_view name;
+		NameKind kind;
+		int distance;
+	};
+
+	// Сжатое префиксное дерево над названиями остановок и маршрутов.
+	// Узлы и рёбра хранятся в плоских массивах, названия - в лексикографическом порядке,
+	// поэтому все названия поддерева образуют непрерывный диапазон.
+	// Названия считаются строками UTF-8: метки рёбер не разрезают символов, а правки считаются
+	// по символам, так что замена кириллической буквы - одна правка. Байт, который не начинает
+	// корректную последовательность UTF-8, считается отдельным символом.
+	// Названия не копируются: string_view должны жить дольше индекса
+	class NameIndex {
+	public:
+		NameIndex() = default;
+
+		explicit NameIndex(std::vector<NameEntry> entries);
+
+		// Возвращает не более limit названий, отличающихся от запроса не более чем на max_errors правок.
+		// При is_prefix запрос сравнивается с началом названия, иначе - с названием целиком.
+		// Результаты упорядочены по числу правок, затем по названию
+		std::vector<SearchResult> Search(std::string_view query, int max_errors, bool is_prefix, size_t limit) const;
+
+		// Оценка памяти, занятой узлами и названиями, в байтах; сами строки названий принадлежат справочнику
+		size_t MemoryUsage() const;
+
+	private:
+		struct Node {
+			// Метка ребра, ведущего в узел
+			std::string_view label;
+			uint32_t first_child = 0;
+			uint32_t children_count = 0;
+			// Названия, заканчивающиеся в узле: [entries_begin, terminal_end),
+			// все названия поддерева: [entries_begin, subtree_end)
+			uint32_t entries_begin = 0;
+			uint32_t terminal_end = 0;
+			uint32_t subtree_end = 0;
+		};
+
+		struct MatchedRange {
+			uint32_t begin;
+			uint32_t end;
+			int distance;
+		};
+
+		struct SearchContext {
+			// Символы запроса, см. ReadSymbol в search_index.cpp
+			std::vector<uint32_t> query;
+			int max_errors;
+			bool is_prefix;
+			// rows[depth] - расстояния от префиксов запроса до префикса названия из depth символов
+			std::vector<int> rows;
+			std::vector<MatchedRange> matched_ranges;
+		};
+
+		std::vector<NameEntry> entries_;
+		std::vector<Node> nodes_;
+
+		void BuildNode(uint32_t node_index, uint32_t begin, uint32_t end, size_t depth);
+
+		void CheckNodeEnd(const Node& node, size_t depth, SearchContext& context) const;
+
+		void SearchChildren(const Node& node, size_t depth, SearchContext& context) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "serialization.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace serialization {
+
+	using namespace std::literals;
+
+	namespace {
+		constexpr char FORMAT_MAGIC[4] = { 'T', 'C', 'A', 'T' };
+		// Записывается в заголовок, чтобы не читать файл, созданный на машине с другим порядком байтов
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		// Длины и счётчики из файла не проверены, поэтому память под строки и массивы выделяется
+		// не больше чем на столько элементов вперёд прочитанного: повреждённая длина заканчивается
+		// ошибкой на конце файла, а не огромным выделением
+		constexpr size_t READ_CHUNK_SIZE = 1 << 16;
+
+		enum class ColorTag : uint8_t {
+			NONE,
+			STRING,
+			RGB,
+			RGBA
+		};
+
+		template <typename Number>
+		void WriteNumber(std::ostream& output, Number value) {
+			static_assert(std::is_arithmetic_v<Number>);
+			output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		template <typename Number>
+		Number ReadNumber(std::istream& input) {
+			static_assert(std::is_arithmetic_v<Number>);
+			Number value{};
+			if (!input.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+				throw SerializationError("Unexpected end of base file"s);
+			}
+			return value;
+		}
+
+		void WriteString(std::ostream& output, std::string_view value) {
+			WriteNumber<uint32_t>(output, static_cast<uint32_t>(value.size()));
+			output.write(value.data(), static_cast<std::streamsize>(value.size()));
+		}
+
+		std::string ReadString(std::istream& input) {
+			const uint32_t size = ReadNumber<uint32_t>(input);
+			std::string value;
+			while (value.size() < size) {
+				const size_t read_size = value.size();
+				value.resize(read_size + std::min<size_t>(size - read_size, READ_CHUNK_SIZE));
+				if (!input.read(value.data() + read_size, static_cast<std::streamsize>(value.size() - read_size))) {
+					throw SerializationError("Corrupt base file: string is longer than the rest of the file"s);
+				}
+			}
+			return value;
+		}
+
+		// Читает счётчик элементов и резервирует в values место не больше чем на READ_CHUNK_SIZE из них
+		template <typename Vector>
+		uint32_t ReadCount(std::istream& input, Vector& values) {
+			const uint32_t count = ReadNumber<uint32_t>(input);
+			values.reserve(std::min<size_t>(count, READ_CHUNK_SIZE));
+			return count;
+		}
+
+		void WritePoint(std::ostream& output, svg::Point point) {
+			WriteNumber(output, point.x);
+			WriteNumber(output, point.y);
+		}
+
+		svg::Point ReadPoint(std::istream& input) {
+			const double x = ReadNumber<double>(input);
+			const double y = ReadNumber<double>(input);
+			return { x, y };
+		}
+
+		void WriteColor(std::ostream& output, const svg::Color& color) {
+			if (std::holds_alternative<std::string>(color)) {
+				WriteNumber(output, static_cast<uint8_t>(ColorTag::STRING));
+				WriteString(output, std::get<std::string>(color));
+			}
+			else if (std::holds_alternative<svg::Rgb>(color)) {
+				const svg::Rgb& rgb = std::get<svg::Rgb>(color);
+				WriteNumber(output, static_cast<uint8_t>(ColorTag::RGB));
+				WriteNumber(output, rgb.red);
+				WriteNumber(output, rgb.green);
+				WriteNumber(output, rgb.blue);
+			}
+			else if (std::holds_alternative<svg::Rgba>(color)) {
+				const svg::Rgba& rgba = std::get<svg::Rgba>(color);
+				WriteNumber(output, static_cast<uint8_t>(ColorTag::RGBA));
+				WriteNumber(output, rgba.red);
+				WriteNumber(output, rgba.green);
+				WriteNumber(output, rgba.blue);
+				WriteNumber(output, rgba.opacity);
+			}
+			else {
+				WriteNumber(output, static_cast<uint8_t>(ColorTag::NONE));
+			}
+		}
+
+		svg::Color ReadColor(std::istream& input) {
+			switch (static_cast<ColorTag>(ReadNumber<uint8_t>(input))) {
+			case ColorTag::NONE:
+				return svg::NoneColor;
+			case ColorTag::STRING:
+				return ReadString(input);
+			case ColorTag::RGB: {
+				const uint8_t red = ReadNumber<uint8_t>(input);
+				const uint8_t green = ReadNumber<uint8_t>(input);
+				const uint8_t blue = ReadNumber<uint8_t>(input);
+				return svg::Rgb{ red, green, blue };
+			}
+			case ColorTag::RGBA: {
+				const uint8_t red = ReadNumber<uint8_t>(input);
+				const uint8_t green = ReadNumber<uint8_t>(input);
+				const uint8_t blue = ReadNumber<uint8_t>(input);
+				const double opacity = ReadNumber<double>(input);
+				return svg::Rgba{ red, green, blue, opacity };
+			}
+			default:
+				throw SerializationError("Unknown color type in base file"s);
+			}
+		}
+
+		void SerializeRenderSettings(const map_renderer::RenderSettings& render_settings, std::ostream& output) {
+			WritePoint(output, render_settings.picture_size);
+			WriteNumber(output, render_settings.padding);
+			WriteNumber(output, render_settings.line_width);
+			WriteNumber(output, render_settings.stop_radius);
+			WriteNumber<int32_t>(output, render_settings.bus_label_font_size);
+			WritePoint(output, render_settings.bus_label_offset);
+			WriteNumber<int32_t>(output, render_settings.stop_label_font_size);
+			WritePoint(output, render_settings.stop_label_offset);
+			WriteColor(output, render_settings.underlayer_color);
+			WriteNumber(output, render_settings.underlayer_width);
+			WriteNumber<uint32_t>(output, static_cast<uint32_t>(render_settings.color_palette.size()));
+			for (const auto& color : render_settings.color_palette) {
+				WriteColor(output, color);
+			}
+		}
+
+		map_renderer::RenderSettings DeserializeRenderSettings(std::istream& input) {
+			map_renderer::RenderSettings render_settings;
+			render_settings.picture_size = ReadPoint(input);
+			render_settings.padding = ReadNumber<double>(input);
+			render_settings.line_width = ReadNumber<double>(input);
+			render_settings.stop_radius = ReadNumber<double>(input);
+			render_settings.bus_label_font_size = ReadNumber<int32_t>(input);
+			render_settings.bus_label_offset = ReadPoint(input);
+			render_settings.stop_label_font_size = ReadNumber<int32_t>(input);
+			render_settings.stop_label_offset = ReadPoint(input);
+			render_settings.underlayer_color = ReadColor(input);
+			render_settings.underlayer_width = ReadNumber<double>(input);
+			const uint32_t palette_size = ReadCount(input, render_settings.color_palette);
+			for (uint32_t i = 0; i < palette_size; ++i) {
+				render_settings.color_palette.push_back(ReadColor(input));
+			}
+			return render_settings;
+		}
+	}
+
+	std::string SerializeRenderSettings(const map_renderer::RenderSettings& render_settings) {
+		std::ostringstream output;
+		SerializeRenderSettings(render_settings, output);
+		return std::move(output).str();
+	}
+
+	map_renderer::RenderSettings DeserializeRenderSettings(std::string_view data) {
+		std::istringstream input{ std::string(data) };
+		map_renderer::RenderSettings render_settings = DeserializeRenderSettings(input);
+		if (input.peek() != std::istringstream::traits_type::eof()) {
+			throw SerializationError("Corrupt base file: unexpected data after render settings"s);
+		}
+		return render_settings;
+	}
+
+	void SerializeBase(const transport_catalogue::TransportCatalogue& catalogue,
+	                   const map_renderer::RenderSettings& render_settings,
+	                   std::ostream& output) {
+		output.write(FORMAT_MAGIC, sizeof(FORMAT_MAGIC));
+		WriteNumber(output, FORMAT_VERSION);
+		WriteNumber(output, BYTE_ORDER_MARK);
+
+		const auto& stops = catalogue.GetStopsList();
+		WriteNumber<uint32_t>(output, static_cast<uint32_t>(stops.size()));
+		for (const auto& stop : stops) {
+			WriteString(output, stop.stop_name);
+			WriteNumber(output, stop.stop_coordinates.lat);
+			WriteNumber(output, stop.stop_coordinates.lng);
+		}
+
+		const auto& buses = catalogue.GetBusesList();
+		WriteNumber<uint32_t>(output, static_cast<uint32_t>(buses.size()));
+		for (const auto& bus : buses) {
+			WriteString(output, bus.bus_name);
+			WriteNumber<uint8_t>(output, bus.is_roundtrip ? 1 : 0);
+			WriteNumber<uint32_t>(output, static_cast<uint32_t>(bus.bus_stops.size()));
+			for (const auto& stop : bus.bus_stops) {
+				WriteNumber<uint32_t>(output, static_cast<uint32_t>(stop->stop_id));
+			}
+		}
+
+		// Расстояние без одной из остановок записать нечем; справочник таких не хранит, но файл не должен
+		// получить висячий номер остановки, даже если они появятся
+		const auto& distances = catalogue.GetDistances();
+		const auto has_both_stops = [](const auto& distance) {
+			return distance.first.first != nullptr && distance.first.second != nullptr;
+		};
+		WriteNumber<uint32_t>(output, static_cast<uint32_t>(std::count_if(distances.begin(), distances.end(), has_both_stops)));
+		for (const auto& [stops_pair, distance] : distances) {
+			if (stops_pair.first == nullptr || stops_pair.second == nullptr) {
+				continue;
+			}
+			WriteNumber<uint32_t>(output, static_cast<uint32_t>(stops_pair.first->stop_id));
+			WriteNumber<uint32_t>(output, static_cast<uint32_t>(stops_pair.second->stop_id));
+			WriteNumber<int32_t>(output, distance);
+		}
+
+		SerializeRenderSettings(render_settings, output);
+		if (!output) {
+			throw SerializationError("Failed to write base file"s);
+		}
+	}
+
+	void DeserializeBase(std::istream& input,
+	                     transport_catalogue::TransportCatalogue& catalogue,
+	                     map_renderer::RenderSettings& render_settings) {
+		char magic[sizeof(FORMAT_MAGIC)] = {};
+		if (!input.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != std::string_view(FORMAT_MAGIC, sizeof(FORMAT_MAGIC))) {
+			throw SerializationError("File is not a transport catalogue base"s);
+		}
+		if (ReadNumber<uint32_t>(input) != FORMAT_VERSION) {
+			throw SerializationError("Unsupported base file version"s);
+		}
+		if (ReadNumber<uint32_t>(input) != BYTE_ORDER_MARK) {
+			throw SerializationError("Base file was written with another byte order"s);
+		}
+
+		const uint32_t stops_count = ReadNumber<uint32_t>(input);
+		for (uint32_t i = 0; i < stops_count; ++i) {
+			std::string stop_name = ReadString(input);
+			const double lat = ReadNumber<double>(input);
+			const double lng = ReadNumber<double>(input);
+			// NaN и бесконечности не проходят ни одно из сравнений
+			if (!(lat >= -90.0 && lat <= 90.0 && lng >= -180.0 && lng <= 180.0)) {
+				throw SerializationError("Corrupt base file: stop coordinates are out of range"s);
+			}
+			catalogue.AddStop(std::move(stop_name), { lat, lng });
+		}
+		const auto& stops = catalogue.GetStopsList();
+		auto read_stop = [&input, &stops]() -> const domain::Stop& {
+			const uint32_t stop_id = ReadNumber<uint32_t>(input);
+			if (stop_id >= stops.size()) {
+				throw SerializationError("Invalid stop reference in base file"s);
+			}
+			return stops[stop_id];
+		};
+
+		const uint32_t buses_count = ReadNumber<uint32_t>(input);
+		for (uint32_t i = 0; i < buses_count; ++i) {
+			std::string bus_name = ReadString(input);
+			const bool is_roundtrip = ReadNumber<uint8_t>(input) != 0;
+			std::vector<std::string_view> bus_stops;
+			const uint32_t bus_stops_count = ReadCount(input, bus_stops);
+			for (uint32_t j = 0; j < bus_stops_count; ++j) {
+				bus_stops.push_back(read_stop().stop_name);
+			}
+			catalogue.AddBus(std::move(bus_name), bus_stops, is_roundtrip);
+		}
+
+		const uint32_t distances_count = ReadNumber<uint32_t>(input);
+		for (uint32_t i = 0; i < distances_count; ++i) {
+			const domain::Stop& from_stop = read_stop();
+			const domain::Stop& to_stop = read_stop();
+			catalogue.SetDistanceBetweenStops(&from_stop, &to_stop, ReadNumber<int32_t>(input));
+		}
+
+		render_settings = DeserializeRenderSettings(input);
+		catalogue.BuildIndexes();
+	}
+}
\ No newline at end of file
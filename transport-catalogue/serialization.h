@@ -0,0 +1,51 @@
+#pragma once
+
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+	// Эта ошибка выбрасывается, если файл базы повреждён или записан другой версией формата
+	class SerializationError : public std::runtime_error {
+	public:
+		using runtime_error::runtime_error;
+	};
+
+	enum class BaseFormat {
+		// Компактный поток, который при загрузке разворачивается в TransportCatalogue
+		BINARY,
+		// Образ для отображения в память: запросы обслуживаются прямо из файла (см. mapped_catalogue.h)
+		MAPPED
+	};
+
+	struct SerializationSettings {
+		std::filesystem::path file;
+		BaseFormat format = BaseFormat::BINARY;
+	};
+
+	// Версия двоичного формата базы; увеличивается при любом несовместимом изменении
+	inline constexpr uint32_t FORMAT_VERSION = 1;
+
+	// Записывает остановки, маршруты, расстояния и настройки визуализации в двоичном виде
+	void SerializeBase(const transport_catalogue::TransportCatalogue& catalogue,
+	                   const map_renderer::RenderSettings& render_settings,
+	                   std::ostream& output);
+
+	// Восстанавливает справочник и настройки визуализации; индексы справочника строятся заново
+	void DeserializeBase(std::istream& input,
+	                     transport_catalogue::TransportCatalogue& catalogue,
+	                     map_renderer::RenderSettings& render_settings);
+
+	// Настройки визуализации в формате базы; образ для отображения в память хранит их в отдельном разделе
+	std::string SerializeRenderSettings(const map_renderer::RenderSettings& render_settings);
+
+	// Бросает SerializationError, если data не содержит ровно одни настройки визуализации
+	map_renderer::RenderSettings DeserializeRenderSettings(std::string_view data);
+}
\ No newline at end of file
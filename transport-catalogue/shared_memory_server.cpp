@@ -0,0 +1,440 @@
+#include "shared_memory_server.h"
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shared_memory_server {
+
+	using namespace std::literals;
+
+	struct SegmentHeader {
+		uint64_t magic;
+		uint32_t version;
+		uint64_t ring_capacity;
+		// Клиент подключается, только когда сервер разметил сегмент и выставил этот флаг
+		std::atomic<uint32_t> is_server_running;
+		// pid подключённого клиента или 0
+		std::atomic<uint32_t> client_pid;
+		// Клиент при подключении увеличивает session, а сервер опустошает кольца и подтверждает
+		// номер в accepted_session; до подтверждения клиент кольцами не пользуется
+		std::atomic<uint64_t> session;
+		std::atomic<uint64_t> accepted_session;
+		RingControl requests;
+		RingControl responses;
+	};
+
+	namespace {
+		constexpr uint64_t SEGMENT_MAGIC = 0x4d48535441435454; // "TTCATSHM"
+		constexpr uint32_t SEGMENT_VERSION = 2;
+		// Заголовок фрагмента - его длина; старший бит означает, что за фрагментом следует продолжение
+		constexpr uint32_t MORE_FRAGMENTS_FLAG = 1u << 31;
+		constexpr size_t FRAGMENT_HEADER_SIZE = sizeof(uint32_t);
+		constexpr size_t MIN_RING_CAPACITY = 4096;
+		constexpr size_t MAX_RING_CAPACITY = 1u << 30;
+		// Ответы сервера ограничены только здравым смыслом: карта большого города занимает мегабайты
+		constexpr size_t MAX_RESPONSE_SIZE = 1u << 30;
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		              "Shared memory rings need lock-free atomics");
+
+		[[noreturn]] void ThrowSystemError(const char* operation) {
+			throw std::system_error(errno, std::generic_category(), operation);
+		}
+
+		std::string GetObjectName(const std::string& name) {
+			if (name.empty() || name.find('/', 1) != std::string::npos) {
+				throw std::invalid_argument("Invalid shared memory name: "s + name);
+			}
+			return name.front() == '/' ? name : "/"s + name;
+		}
+
+		size_t GetSegmentSize(size_t ring_capacity) {
+			return sizeof(SegmentHeader) + 2 * ring_capacity;
+		}
+
+		char* GetRequestsData(SegmentHeader* header) {
+			return reinterpret_cast<char*>(header) + sizeof(SegmentHeader);
+		}
+
+		char* GetResponsesData(SegmentHeader* header) {
+			return GetRequestsData(header) + header->ring_capacity;
+		}
+
+		void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			asm volatile("yield");
+#endif
+		}
+
+		// Ожидание очередного сообщения: сначала без системных вызовов, затем с уступкой процессора
+		// и, если сообщений долго нет, с короткими засыпаниями. На одном процессоре другая сторона
+		// не может работать, пока мы крутимся, поэтому процессор уступается сразу
+		class Backoff {
+		public:
+			void Pause() {
+				static const int spin_limit = std::thread::hardware_concurrency() > 1 ? SPIN_LIMIT : 0;
+				if (spins_ < spin_limit) {
+					CpuRelax();
+				}
+				else if (spins_ < spin_limit + YIELD_LIMIT) {
+					std::this_thread::yield();
+				}
+				else {
+					std::this_thread::sleep_for(IDLE_SLEEP);
+					return;
+				}
+				++spins_;
+			}
+
+			void Reset() {
+				spins_ = 0;
+			}
+
+		private:
+			static constexpr int SPIN_LIMIT = 4096;
+			static constexpr int YIELD_LIMIT = 256;
+			static constexpr auto IDLE_SLEEP = 50us;
+
+			int spins_ = 0;
+		};
+	}
+
+	Ring::Ring(RingControl& control, char* data, size_t capacity, size_t max_message_size)
+		:control_(control)
+		, data_(data)
+		, capacity_(capacity)
+		, max_message_size_(max_message_size)
+		, cached_read_position_(control.read_position.load(std::memory_order_acquire))
+		, cached_write_position_(control.write_position.load(std::memory_order_acquire))
+	{
+	}
+
+	bool Ring::Write(std::string_view message, size_t& offset) {
+		const uint64_t write_position = control_.write_position.load(std::memory_order_relaxed);
+		const size_t remaining_size = message.size() - offset;
+		// Сообщение, которое не помещается в свободное место целиком, делится на фрагменты, но не мельче
+		// четверти кольца, чтобы большой ответ не расходовался на заголовки
+		const size_t min_fragment_size = std::min(remaining_size, capacity_ / 4);
+		auto get_free_size = [&] {
+			return capacity_ - static_cast<size_t>(write_position - cached_read_position_);
+		};
+		if (get_free_size() < FRAGMENT_HEADER_SIZE + min_fragment_size) {
+			cached_read_position_ = control_.read_position.load(std::memory_order_acquire);
+			if (get_free_size() < FRAGMENT_HEADER_SIZE + min_fragment_size) {
+				return false;
+			}
+		}
+		const size_t fragment_size = std::min(remaining_size, get_free_size() - FRAGMENT_HEADER_SIZE);
+		const bool is_last = fragment_size == remaining_size;
+		const uint32_t fragment_header = static_cast<uint32_t>(fragment_size) | (is_last ? 0 : MORE_FRAGMENTS_FLAG);
+		CopyIn(write_position, reinterpret_cast<const char*>(&fragment_header), FRAGMENT_HEADER_SIZE);
+		CopyIn(write_position + FRAGMENT_HEADER_SIZE, message.data() + offset, fragment_size);
+		control_.write_position.store(write_position + FRAGMENT_HEADER_SIZE + fragment_size, std::memory_order_release);
+		offset += fragment_size;
+		return is_last;
+	}
+
+	bool Ring::Read(std::string& message) {
+		uint64_t read_position = control_.read_position.load(std::memory_order_relaxed);
+		while (true) {
+			if (cached_write_position_ - read_position < FRAGMENT_HEADER_SIZE) {
+				cached_write_position_ = control_.write_position.load(std::memory_order_acquire);
+				if (cached_write_position_ - read_position < FRAGMENT_HEADER_SIZE) {
+					return false;
+				}
+			}
+			const uint64_t available_size = cached_write_position_ - read_position;
+			if (available_size > capacity_) {
+				throw std::runtime_error("Corrupted shared memory ring: write position is out of range"s);
+			}
+			// Писатель публикует заголовок вместе с данными фрагмента, так что данные уже на месте
+			uint32_t fragment_header = 0;
+			CopyOut(read_position, reinterpret_cast<char*>(&fragment_header), FRAGMENT_HEADER_SIZE);
+			const size_t fragment_size = fragment_header & ~MORE_FRAGMENTS_FLAG;
+			if (fragment_size > available_size - FRAGMENT_HEADER_SIZE) {
+				throw std::runtime_error("Corrupted shared memory ring: fragment exceeds written data"s);
+			}
+			const size_t message_size = message.size();
+			if (fragment_size > max_message_size_ - message_size) {
+				throw std::runtime_error("Shared memory message exceeds "s + std::to_string(max_message_size_) + " bytes"s);
+			}
+			message.resize(message_size + fragment_size);
+			CopyOut(read_position + FRAGMENT_HEADER_SIZE, message.data() + message_size, fragment_size);
+			read_position += FRAGMENT_HEADER_SIZE + fragment_size;
+			control_.read_position.store(read_position, std::memory_order_release);
+			if ((fragment_header & MORE_FRAGMENTS_FLAG) == 0) {
+				return true;
+			}
+		}
+	}
+
+	void Ring::Reset() {
+		control_.read_position.store(0, std::memory_order_relaxed);
+		control_.write_position.store(0, std::memory_order_relaxed);
+		cached_read_position_ = 0;
+		cached_write_position_ = 0;
+	}
+
+	void Ring::Resynchronize() {
+		cached_read_position_ = control_.read_position.load(std::memory_order_acquire);
+		cached_write_position_ = control_.write_position.load(std::memory_order_acquire);
+	}
+
+	void Ring::CopyIn(uint64_t position, const char* source, size_t size) {
+		const size_t index = static_cast<size_t>(position & (capacity_ - 1));
+		const size_t first_part_size = std::min(size, capacity_ - index);
+		std::memcpy(data_ + index, source, first_part_size);
+		std::memcpy(data_, source + first_part_size, size - first_part_size);
+	}
+
+	void Ring::CopyOut(uint64_t position, char* destination, size_t size) const {
+		const size_t index = static_cast<size_t>(position & (capacity_ - 1));
+		const size_t first_part_size = std::min(size, capacity_ - index);
+		std::memcpy(destination, data_ + index, first_part_size);
+		std::memcpy(destination + first_part_size, data_, size - first_part_size);
+	}
+
+	Server::Server(catalogue_store::CatalogueStore& store, const map_renderer::MapRender& map_renderer,
+	               ServerSettings settings, profiler::Profiler* profiler)
+		:store_(store)
+		, map_renderer_(map_renderer)
+		, settings_(std::move(settings))
+		, profiler_(profiler)
+		, object_name_(GetObjectName(settings_.name))
+	{
+		const size_t ring_capacity = settings_.ring_capacity;
+		if (ring_capacity < MIN_RING_CAPACITY || ring_capacity > MAX_RING_CAPACITY
+		    || (ring_capacity & (ring_capacity - 1)) != 0) {
+			throw std::invalid_argument("Ring capacity must be a power of two between 4 KiB and 1 GiB"s);
+		}
+
+		// Объект, оставшийся от упавшего сервера, заменяем: его клиент всё равно уже не получит ответов
+		shm_unlink(object_name_.c_str());
+		const int descriptor = shm_open(object_name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (descriptor < 0) {
+			ThrowSystemError("shm_open");
+		}
+		segment_size_ = GetSegmentSize(ring_capacity);
+		if (ftruncate(descriptor, static_cast<off_t>(segment_size_)) != 0) {
+			const int error = errno;
+			close(descriptor);
+			shm_unlink(object_name_.c_str());
+			throw std::system_error(error, std::generic_category(), "ftruncate");
+		}
+		segment_ = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		const int error = errno;
+		close(descriptor);
+		if (segment_ == MAP_FAILED) {
+			segment_ = nullptr;
+			shm_unlink(object_name_.c_str());
+			throw std::system_error(error, std::generic_category(), "mmap");
+		}
+
+		auto* header = new (segment_) SegmentHeader{};
+		header->magic = SEGMENT_MAGIC;
+		header->version = SEGMENT_VERSION;
+		header->ring_capacity = ring_capacity;
+		header->is_server_running.store(1, std::memory_order_release);
+	}
+
+	Server::~Server() {
+		auto* header = static_cast<SegmentHeader*>(segment_);
+		header->is_server_running.store(0, std::memory_order_release);
+		munmap(segment_, segment_size_);
+		shm_unlink(object_name_.c_str());
+	}
+
+	void Server::Run() {
+		auto* header = static_cast<SegmentHeader*>(segment_);
+		Ring requests(header->requests, GetRequestsData(header), header->ring_capacity, settings_.max_request_size);
+		Ring responses(header->responses, GetResponsesData(header), header->ring_capacity, MAX_RESPONSE_SIZE);
+
+		std::string request;
+		Backoff backoff;
+		uint64_t session = 0;
+		// Отключённый клиент больше не читается; сервер ждёт подключения следующего
+		bool is_client_dropped = false;
+		while (!is_stopping_.load(std::memory_order_relaxed)) {
+			// Новый клиент: недочитанный запрос и неотданные ответы прежнего выбрасываются
+			if (const uint64_t requested_session = header->session.load(std::memory_order_acquire);
+			    requested_session != session) {
+				requests.Reset();
+				responses.Reset();
+				request.clear();
+				session = requested_session;
+				is_client_dropped = false;
+				header->accepted_session.store(session, std::memory_order_release);
+			}
+			bool is_request_ready = false;
+			if (!is_client_dropped) {
+				try {
+					is_request_ready = requests.Read(request);
+				}
+				catch (const std::runtime_error& error) {
+					std::cerr << "Shared memory client dropped: "s << error.what() << '\n';
+					request.clear();
+					is_client_dropped = true;
+					header->accepted_session.store(0, std::memory_order_release);
+					header->client_pid.store(0, std::memory_order_release);
+				}
+			}
+			if (!is_request_ready) {
+				backoff.Pause();
+				continue;
+			}
+			backoff.Reset();
+			const std::string response = query_server::ProcessRequestLine(request, store_, map_renderer_, profiler_);
+			request.clear();
+			size_t offset = 0;
+			while (!responses.Write(response, offset)) {
+				if (is_stopping_.load(std::memory_order_relaxed)) {
+					return;
+				}
+				if (header->session.load(std::memory_order_relaxed) != session) {
+					break;
+				}
+				backoff.Pause();
+			}
+			backoff.Reset();
+		}
+	}
+
+	void Server::Stop() {
+		is_stopping_.store(true, std::memory_order_relaxed);
+	}
+
+	Client::Client(const std::string& name)
+		:Client(OpenSegment(name))
+	{
+	}
+
+	Client::Client(Mapping mapping)
+		:mapping_(mapping)
+		, header_(static_cast<SegmentHeader*>(mapping.address))
+		, requests_(header_->requests, GetRequestsData(header_), header_->ring_capacity, MAX_RESPONSE_SIZE)
+		, responses_(header_->responses, GetResponsesData(header_), header_->ring_capacity, MAX_RESPONSE_SIZE)
+	{
+		const auto pid = static_cast<uint32_t>(getpid());
+		uint32_t owner_pid = 0;
+		while (!header_->client_pid.compare_exchange_strong(owner_pid, pid, std::memory_order_acq_rel)) {
+			// Место клиента, который завершился, не отключившись, свободно: следующая попытка
+			// заменяет его pid нашим
+			if (owner_pid != 0 && !(kill(static_cast<pid_t>(owner_pid), 0) != 0 && errno == ESRCH)) {
+				munmap(mapping_.address, mapping_.size);
+				throw std::runtime_error("Shared memory server already has a client"s);
+			}
+		}
+
+		session_ = header_->session.fetch_add(1, std::memory_order_acq_rel) + 1;
+		Backoff backoff;
+		while (header_->accepted_session.load(std::memory_order_acquire) != session_) {
+			if (header_->is_server_running.load(std::memory_order_relaxed) == 0) {
+				Detach();
+				throw std::runtime_error("Shared memory server stopped"s);
+			}
+			backoff.Pause();
+		}
+		requests_.Resynchronize();
+		responses_.Resynchronize();
+	}
+
+	Client::~Client() {
+		Detach();
+	}
+
+	void Client::Detach() {
+		uint32_t pid = static_cast<uint32_t>(getpid());
+		header_->client_pid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel);
+		munmap(mapping_.address, mapping_.size);
+	}
+
+	void Client::CheckServer() const {
+		if (header_->is_server_running.load(std::memory_order_relaxed) == 0) {
+			throw std::runtime_error("Shared memory server stopped"s);
+		}
+		if (header_->accepted_session.load(std::memory_order_relaxed) != session_) {
+			throw std::runtime_error("Shared memory server dropped the client"s);
+		}
+	}
+
+	Client::Mapping Client::OpenSegment(const std::string& name) {
+		const std::string object_name = GetObjectName(name);
+		const int descriptor = shm_open(object_name.c_str(), O_RDWR, 0);
+		if (descriptor < 0) {
+			ThrowSystemError("shm_open");
+		}
+		struct stat file_status {};
+		if (fstat(descriptor, &file_status) != 0) {
+			const int error = errno;
+			close(descriptor);
+			throw std::system_error(error, std::generic_category(), "fstat");
+		}
+		const auto size = static_cast<size_t>(file_status.st_size);
+		void* address = size >= sizeof(SegmentHeader)
+			? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0)
+			: MAP_FAILED;
+		close(descriptor);
+		if (address == MAP_FAILED) {
+			throw std::runtime_error("Cannot map shared memory segment "s + object_name);
+		}
+
+		const auto* header = static_cast<const SegmentHeader*>(address);
+		if (header->is_server_running.load(std::memory_order_acquire) == 0
+		    || header->magic != SEGMENT_MAGIC || header->version != SEGMENT_VERSION
+		    || GetSegmentSize(header->ring_capacity) != size) {
+			munmap(address, size);
+			throw std::runtime_error("No running shared memory server at "s + object_name);
+		}
+		return { address, size };
+	}
+
+	void Client::Send(std::string_view request) {
+		size_t offset = 0;
+		Backoff backoff;
+		while (!requests_.Write(request, offset)) {
+			CheckServer();
+			backoff.Pause();
+		}
+	}
+
+	bool Client::TryReceive(std::string& response) {
+		if (!responses_.Read(partial_response_)) {
+			return false;
+		}
+		response = std::move(partial_response_);
+		partial_response_.clear();
+		return true;
+	}
+
+	std::string Client::Receive() {
+		std::string response;
+		Backoff backoff;
+		while (!TryReceive(response)) {
+			CheckServer();
+			backoff.Pause();
+		}
+		return response;
+	}
+
+	std::string Client::Call(std::string_view request) {
+		Send(request);
+		return Receive();
+	}
+}
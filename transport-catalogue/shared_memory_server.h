@@ -0,0 +1,147 @@
+#pragma once
+
+#include "catalogue_store.h"
+#include "map_renderer.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace shared_memory_server {
+
+	// Положение записи и чтения кольца лежат в разных кэш-линиях, чтобы производитель и потребитель
+	// не выбивали друг у друга строку кэша
+	struct RingControl {
+		alignas(64) std::atomic<uint64_t> write_position{ 0 };
+		alignas(64) std::atomic<uint64_t> read_position{ 0 };
+	};
+
+	// Кольцо байтов с одним писателем и одним читателем поверх общей памяти.
+	// Сообщение пишется фрагментами с заголовком длины, поэтому может быть больше самого кольца:
+	// писатель отдаёт очередной фрагмент, как только читатель освободит место
+	class Ring {
+	public:
+		// capacity - степень двойки; Read не собирает сообщений длиннее max_message_size
+		Ring(RingControl& control, char* data, size_t capacity, size_t max_message_size);
+
+		// Пишет следующий фрагмент message начиная с offset и сдвигает offset.
+		// Возвращает true, когда записан последний фрагмент; false - если места в кольце пока нет
+		bool Write(std::string_view message, size_t& offset);
+
+		// Дописывает в message фрагменты из кольца; возвращает true, когда сообщение собрано целиком.
+		// Бросает std::runtime_error, если положения или заголовок фрагмента противоречат кольцу
+		// или сообщение длиннее max_message_size: другой стороне после этого доверять нельзя
+		bool Read(std::string& message);
+
+		// Опустошает кольцо; вызывается, пока другая сторона кольцом не пользуется
+		void Reset();
+
+		// Перечитывает положения после Reset, сделанного другой стороной
+		void Resynchronize();
+
+	private:
+		RingControl& control_;
+		char* data_;
+		size_t capacity_;
+		size_t max_message_size_;
+		// Последние увиденные положения другой стороны: общие переменные читаются, только когда их не хватает
+		uint64_t cached_read_position_;
+		uint64_t cached_write_position_;
+
+		void CopyIn(uint64_t position, const char* source, size_t size);
+		void CopyOut(uint64_t position, char* destination, size_t size) const;
+	};
+
+	struct SegmentHeader;
+
+	struct ServerSettings {
+		// Имя объекта POSIX shared memory; существующий объект с этим именем заменяется
+		std::string name;
+		// Размер каждого из колец запросов и ответов, степень двойки
+		size_t ring_capacity = 1 << 22;
+		// Клиент, приславший запрос длиннее, отключается
+		size_t max_request_size = 1 << 20;
+	};
+
+	// Сервер на общей памяти для клиента на той же машине: запросы и ответы в формате query_server
+	// передаются через пару колец без системных вызовов, пока обе стороны заняты.
+	// Run отвечает на запросы в вызвавшем потоке и опрашивает кольцо запросов, а без запросов
+	// постепенно переходит от активного ожидания к коротким засыпаниям
+	class Server {
+	public:
+		Server(catalogue_store::CatalogueStore& store, const map_renderer::MapRender& map_renderer,
+		       ServerSettings settings, profiler::Profiler* profiler = nullptr);
+		~Server();
+
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// Отвечает на запросы до вызова Stop
+		void Run();
+
+		// Можно вызывать из любого потока и из обработчика сигнала
+		void Stop();
+
+	private:
+		catalogue_store::CatalogueStore& store_;
+		const map_renderer::MapRender& map_renderer_;
+		ServerSettings settings_;
+		profiler::Profiler* profiler_;
+
+		std::string object_name_;
+		void* segment_ = nullptr;
+		size_t segment_size_ = 0;
+		std::atomic<bool> is_stopping_{ false };
+	};
+
+	// Клиент сервера на общей памяти. Одновременно к серверу подключён не больше одного клиента.
+	// Клиент занимает сервер своим pid; место клиента, который завершился, не отключившись,
+	// забирает следующий клиент. При подключении сервер опустошает кольца, так что запросы
+	// и ответы прежнего клиента новому не достаются
+	class Client {
+	public:
+		// Бросает std::runtime_error, если сервер не запущен или занят другим работающим клиентом
+		explicit Client(const std::string& name);
+		~Client();
+
+		Client(const Client&) = delete;
+		Client& operator=(const Client&) = delete;
+
+		// Отправляет запрос, ожидая места в кольце. Пока ответы не читаются, сервер может остановиться
+		// на записи ответа, поэтому неполученных ответов не должно быть больше, чем вмещает кольцо ответов
+		void Send(std::string_view request);
+
+		// Забирает очередной ответ, если он пришёл целиком
+		bool TryReceive(std::string& response);
+
+		// Ждёт очередного ответа; бросает std::runtime_error, если сервер остановился или отключил клиента
+		std::string Receive();
+
+		std::string Call(std::string_view request);
+
+	private:
+		struct Mapping {
+			void* address;
+			size_t size;
+		};
+
+		Mapping mapping_;
+		SegmentHeader* header_;
+		Ring requests_;
+		Ring responses_;
+		std::string partial_response_;
+		// Номер подключения, который сервер подтвердил этому клиенту
+		uint64_t session_ = 0;
+
+		explicit Client(Mapping mapping);
+
+		// Бросает std::runtime_error, если сервер остановился или перешёл к другому подключению
+		void CheckServer() const;
+		void Detach();
+
+		static Mapping OpenSegment(const std::string& name);
+	};
+}
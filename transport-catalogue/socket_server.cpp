@@ -0,0 +1,508 @@
+#include "socket_server.h"
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace socket_server {
+
+	using namespace std::literals;
+
+	namespace {
+		constexpr uint64_t LISTEN_ID = 0;
+		constexpr uint64_t WAKEUP_ID = 1;
+		constexpr uint64_t FIRST_CONNECTION_ID = 2;
+		constexpr int MAX_EVENTS = 64;
+		constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+		constexpr size_t LOOKUP_BURST = 32;
+		// Если дескрипторы заняты не соединениями сервера, закрытия соединения не дождаться,
+		// и приём пробуется снова через это время
+		constexpr int ACCEPT_RETRY_TIMEOUT_MS = 1000;
+
+		[[noreturn]] void ThrowSystemError(const char* operation) {
+			throw std::system_error(errno, std::generic_category(), operation);
+		}
+
+		void CloseDescriptor(int& descriptor) {
+			if (descriptor >= 0) {
+				close(descriptor);
+				descriptor = -1;
+			}
+		}
+
+		bool IsHeavy(query_server::RequestClass request_class) {
+			return request_class != query_server::RequestClass::LOOKUP;
+		}
+
+		bool IsBlankLine(std::string_view line) {
+			return line.find_first_not_of(" \t\r"sv) == std::string_view::npos;
+		}
+	}
+
+	Server::Server(catalogue_store::CatalogueStore& store, const map_renderer::MapRender& map_renderer,
+	               ServerSettings settings, profiler::Profiler* profiler)
+		:store_(store)
+		, map_renderer_(map_renderer)
+		, settings_(std::move(settings))
+		, profiler_(profiler)
+		, next_connection_id_(FIRST_CONNECTION_ID)
+	{
+		if (settings_.workers_count == 0) {
+			throw std::invalid_argument("Server needs at least one worker"s);
+		}
+		heavy_workers_limit_ = settings_.heavy_workers_limit == 0
+			? std::max<size_t>(settings_.workers_count - 1, 1)
+			: std::min(settings_.heavy_workers_limit, settings_.workers_count);
+		wakeup_descriptor_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wakeup_descriptor_ < 0) {
+			ThrowSystemError("eventfd");
+		}
+	}
+
+	Server::~Server() {
+		StopWorkers();
+		CloseSockets();
+		CloseDescriptor(wakeup_descriptor_);
+	}
+
+	void Server::Run() {
+		OpenSockets();
+		StartWorkers();
+
+		epoll_event events[MAX_EVENTS];
+		while (!is_stopping_.load(std::memory_order_acquire)) {
+			const bool is_accept_retry = is_accept_paused_ && connections_.empty();
+			const int events_count = epoll_wait(epoll_descriptor_, events, MAX_EVENTS,
+			                                    is_accept_retry ? ACCEPT_RETRY_TIMEOUT_MS : -1);
+			if (events_count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				ThrowSystemError("epoll_wait");
+			}
+			if (is_accept_retry && is_accept_paused_) {
+				ResumeAccepting();
+			}
+			for (int i = 0; i < events_count; ++i) {
+				const uint64_t id = events[i].data.u64;
+				if (id == LISTEN_ID) {
+					AcceptConnections();
+				}
+				else if (id == WAKEUP_ID) {
+					uint64_t counter = 0;
+					[[maybe_unused]] const ssize_t read_size = read(wakeup_descriptor_, &counter, sizeof(counter));
+					HandleResults();
+				}
+				else {
+					HandleConnectionEvents(id, events[i].events);
+				}
+			}
+		}
+
+		StopWorkers();
+		CloseSockets();
+	}
+
+	void Server::Stop() {
+		is_stopping_.store(true, std::memory_order_release);
+		Wakeup();
+	}
+
+	void Server::Wakeup() {
+		const uint64_t increment = 1;
+		[[maybe_unused]] const ssize_t write_size = write(wakeup_descriptor_, &increment, sizeof(increment));
+	}
+
+	void Server::OpenSockets() {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (settings_.socket_path.empty() || settings_.socket_path.size() >= sizeof(address.sun_path)) {
+			throw std::invalid_argument("Invalid socket path: "s + settings_.socket_path);
+		}
+		std::memcpy(address.sun_path, settings_.socket_path.c_str(), settings_.socket_path.size() + 1);
+
+		// Сокет, оставшийся от прошлого запуска, мешает bind; обычные файлы не трогаем
+		struct stat file_status {};
+		if (lstat(settings_.socket_path.c_str(), &file_status) == 0 && S_ISSOCK(file_status.st_mode)) {
+			unlink(settings_.socket_path.c_str());
+		}
+
+		listen_descriptor_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (listen_descriptor_ < 0) {
+			ThrowSystemError("socket");
+		}
+		if (bind(listen_descriptor_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+			ThrowSystemError("bind");
+		}
+		if (listen(listen_descriptor_, SOMAXCONN) != 0) {
+			ThrowSystemError("listen");
+		}
+
+		epoll_descriptor_ = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_descriptor_ < 0) {
+			ThrowSystemError("epoll_create1");
+		}
+		epoll_event listen_event{};
+		listen_event.events = EPOLLIN;
+		listen_event.data.u64 = LISTEN_ID;
+		epoll_event wakeup_event{};
+		wakeup_event.events = EPOLLIN;
+		wakeup_event.data.u64 = WAKEUP_ID;
+		if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, listen_descriptor_, &listen_event) != 0
+		    || epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, wakeup_descriptor_, &wakeup_event) != 0) {
+			ThrowSystemError("epoll_ctl");
+		}
+	}
+
+	void Server::CloseSockets() {
+		for (auto& [connection_id, connection] : connections_) {
+			CloseDescriptor(connection.descriptor);
+		}
+		connections_.clear();
+		if (listen_descriptor_ >= 0) {
+			CloseDescriptor(listen_descriptor_);
+			unlink(settings_.socket_path.c_str());
+		}
+		CloseDescriptor(epoll_descriptor_);
+	}
+
+	void Server::StartWorkers() {
+		{
+			std::lock_guard guard(tasks_mutex_);
+			is_tasks_closed_ = false;
+		}
+		for (size_t i = 0; i < settings_.workers_count; ++i) {
+			workers_.emplace_back([this] { WorkerLoop(); });
+		}
+	}
+
+	void Server::StopWorkers() {
+		{
+			std::lock_guard guard(tasks_mutex_);
+			is_tasks_closed_ = true;
+			lookup_tasks_.clear();
+			heavy_tasks_.clear();
+		}
+		tasks_condition_.notify_all();
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+		workers_.clear();
+	}
+
+	void Server::WorkerLoop() {
+		while (true) {
+			Task task;
+			{
+				std::unique_lock lock(tasks_mutex_);
+				tasks_condition_.wait(lock, [this] { return is_tasks_closed_ || HasRunnableTaskLocked(); });
+				if (is_tasks_closed_) {
+					return;
+				}
+				task = PopTaskLocked();
+			}
+			std::string response = query_server::ProcessRequestLine(task.request, store_, map_renderer_, profiler_,
+			                                                                task.received_at);
+			if (IsHeavy(task.request_class)) {
+				{
+					std::lock_guard guard(tasks_mutex_);
+					--running_heavy_tasks_;
+				}
+				tasks_condition_.notify_one();
+			}
+			{
+				std::lock_guard guard(results_mutex_);
+				results_.push_back({ task.connection_id, task.sequence, std::move(response) });
+			}
+			Wakeup();
+		}
+	}
+
+	bool Server::HasRunnableTaskLocked() const {
+		return !lookup_tasks_.empty() || (!heavy_tasks_.empty() && running_heavy_tasks_ < heavy_workers_limit_);
+	}
+
+	Server::Task Server::PopTaskLocked() {
+		const bool can_run_heavy = !heavy_tasks_.empty() && running_heavy_tasks_ < heavy_workers_limit_;
+		if (!lookup_tasks_.empty() && !(can_run_heavy && lookups_since_heavy_ >= LOOKUP_BURST)) {
+			Task task = std::move(lookup_tasks_.front());
+			lookup_tasks_.pop_front();
+			if (!heavy_tasks_.empty()) {
+				++lookups_since_heavy_;
+			}
+			return task;
+		}
+		Task task = std::move(heavy_tasks_.front());
+		heavy_tasks_.pop_front();
+		++running_heavy_tasks_;
+		lookups_since_heavy_ = 0;
+		return task;
+	}
+
+	void Server::AcceptConnections() {
+		while (true) {
+			const int descriptor = accept4(listen_descriptor_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (descriptor < 0) {
+				if (errno == EINTR || errno == ECONNABORTED) {
+					continue;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return;
+				}
+				if (errno == EMFILE || errno == ENFILE) {
+					PauseAccepting(errno);
+					return;
+				}
+				ThrowSystemError("accept4");
+			}
+			const uint64_t connection_id = next_connection_id_++;
+			Connection& connection = connections_[connection_id];
+			connection.descriptor = descriptor;
+			connection.events = EPOLLIN;
+			epoll_event event{};
+			event.events = connection.events;
+			event.data.u64 = connection_id;
+			if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+				CloseConnection(connection_id);
+			}
+		}
+	}
+
+	void Server::PauseAccepting(int error_code) {
+		if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, listen_descriptor_, nullptr) != 0) {
+			ThrowSystemError("epoll_ctl");
+		}
+		is_accept_paused_ = true;
+		std::cerr << "Socket server stopped accepting connections: "sv << std::strerror(error_code)
+		          << "; open connections: "sv << connections_.size() << '\n';
+	}
+
+	void Server::ResumeAccepting() {
+		epoll_event listen_event{};
+		listen_event.events = EPOLLIN;
+		listen_event.data.u64 = LISTEN_ID;
+		if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, listen_descriptor_, &listen_event) != 0) {
+			ThrowSystemError("epoll_ctl");
+		}
+		is_accept_paused_ = false;
+		std::cerr << "Socket server resumed accepting connections\n"sv;
+	}
+
+	void Server::HandleConnectionEvents(uint64_t connection_id, uint32_t events) {
+		auto position = connections_.find(connection_id);
+		if (position == connections_.end()) {
+			return;
+		}
+		Connection& connection = position->second;
+		// EPOLLHUP приходит, когда клиент закрыл сокет целиком: ответы ему уже не доставить.
+		// Клиент, закрывший только запись, получает ответы на всё, что успел прислать
+		if (events & (EPOLLERR | EPOLLHUP)) {
+			CloseConnection(connection_id);
+			return;
+		}
+		if ((events & EPOLLIN) && !ReadInput(connection_id, connection)) {
+			CloseConnection(connection_id);
+			return;
+		}
+		if ((events & EPOLLOUT) && !WriteOutput(connection)) {
+			CloseConnection(connection_id);
+			return;
+		}
+		UpdateConnection(connection_id, connection);
+	}
+
+	void Server::HandleResults() {
+		std::vector<Result> results;
+		{
+			std::lock_guard guard(results_mutex_);
+			results.swap(results_);
+		}
+		std::map<uint64_t, Connection*> touched_connections;
+		for (Result& result : results) {
+			auto position = connections_.find(result.connection_id);
+			if (position == connections_.end()) {
+				continue;
+			}
+			Connection& connection = position->second;
+			--connection.in_flight;
+			// Update исполняется в одиночку, так что его ответ - последний из выданных
+			if (--connection.running_tasks == 0) {
+				connection.is_update_running = false;
+			}
+			connection.ready_responses.emplace(result.sequence, std::move(result.response));
+			touched_connections.emplace(result.connection_id, &connection);
+		}
+		for (auto& [connection_id, connection] : touched_connections) {
+			auto& ready_responses = connection->ready_responses;
+			for (auto position = ready_responses.begin();
+			     position != ready_responses.end() && position->first == connection->next_sequence_to_write;
+			     position = ready_responses.erase(position)) {
+				connection->output.append(position->second).push_back('\n');
+				++connection->next_sequence_to_write;
+			}
+			// Освободившиеся места занимают запросы, уже прочитанные из сокета, а отложенные до конца Update
+			// уходят рабочим потокам
+			if (!ExtractRequests(connection_id, *connection) || !WriteOutput(*connection)) {
+				CloseConnection(connection_id);
+				continue;
+			}
+			UpdateConnection(connection_id, *connection);
+		}
+	}
+
+	bool Server::ReadInput(uint64_t connection_id, Connection& connection) {
+		char buffer[READ_CHUNK_SIZE];
+		// Читаем, пока есть место для новых запросов: остальное подождёт в буфере сокета
+		while (!connection.is_peer_closed && connection.in_flight < settings_.max_in_flight_per_connection) {
+			const ssize_t read_size = read(connection.descriptor, buffer, sizeof(buffer));
+			if (read_size > 0) {
+				connection.input.append(buffer, static_cast<size_t>(read_size));
+			}
+			else if (read_size < 0 && errno == EINTR) {
+				continue;
+			}
+			else if (read_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			}
+			else {
+				connection.is_peer_closed = true;
+			}
+			if (!ExtractRequests(connection_id, connection)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Server::ExtractRequests(uint64_t connection_id, Connection& connection) {
+		size_t line_begin = 0;
+		std::vector<Task> tasks;
+		const auto received_at = deadline::Deadline::Clock::now();
+		while (connection.in_flight < settings_.max_in_flight_per_connection) {
+			const size_t line_end = connection.input.find('\n', line_begin);
+			if (line_end == std::string::npos) {
+				break;
+			}
+			std::string_view line(connection.input.data() + line_begin, line_end - line_begin);
+			line_begin = line_end + 1;
+			if (IsBlankLine(line)) {
+				continue;
+			}
+			tasks.push_back({ connection_id, connection.next_sequence++, std::string(line),
+			                  query_server::ClassifyRequestLine(line), received_at });
+			++connection.in_flight;
+		}
+		connection.input.erase(0, line_begin);
+		// Последняя строка без перевода строки от закрывшегося клиента - тоже запрос
+		if (connection.is_peer_closed && connection.in_flight < settings_.max_in_flight_per_connection
+		    && !IsBlankLine(connection.input)) {
+			const query_server::RequestClass request_class = query_server::ClassifyRequestLine(connection.input);
+			tasks.push_back({ connection_id, connection.next_sequence++, std::move(connection.input), request_class,
+			                  received_at });
+			connection.input.clear();
+			++connection.in_flight;
+		}
+		ScheduleTasks(connection, std::move(tasks));
+		return connection.input.size() <= settings_.max_request_size;
+	}
+
+	void Server::ScheduleTasks(Connection& connection, std::vector<Task> tasks) {
+		for (Task& task : tasks) {
+			connection.held_tasks.push_back(std::move(task));
+		}
+		std::vector<Task> runnable_tasks;
+		while (!connection.held_tasks.empty() && !connection.is_update_running) {
+			Task& task = connection.held_tasks.front();
+			if (task.request_class == query_server::RequestClass::UPDATE) {
+				if (connection.running_tasks > 0) {
+					break;
+				}
+				connection.is_update_running = true;
+			}
+			++connection.running_tasks;
+			runnable_tasks.push_back(std::move(task));
+			connection.held_tasks.pop_front();
+		}
+		if (runnable_tasks.empty()) {
+			return;
+		}
+		{
+			std::lock_guard guard(tasks_mutex_);
+			for (Task& task : runnable_tasks) {
+				(IsHeavy(task.request_class) ? heavy_tasks_ : lookup_tasks_).push_back(std::move(task));
+			}
+		}
+		tasks_condition_.notify_all();
+	}
+
+	bool Server::WriteOutput(Connection& connection) {
+		size_t written_size = 0;
+		while (written_size < connection.output.size()) {
+			const ssize_t write_size = send(connection.descriptor, connection.output.data() + written_size,
+			                                connection.output.size() - written_size, MSG_NOSIGNAL);
+			if (write_size > 0) {
+				written_size += static_cast<size_t>(write_size);
+				continue;
+			}
+			if (write_size < 0 && errno == EINTR) {
+				continue;
+			}
+			if (write_size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			}
+			return false;
+		}
+		connection.output.erase(0, written_size);
+		return true;
+	}
+
+	void Server::UpdateConnection(uint64_t connection_id, Connection& connection) {
+		if (connection.is_peer_closed && connection.in_flight == 0 && connection.output.empty()
+		    && connection.ready_responses.empty()) {
+			CloseConnection(connection_id);
+			return;
+		}
+		uint32_t events = 0;
+		if (!connection.is_peer_closed && connection.in_flight < settings_.max_in_flight_per_connection) {
+			events |= EPOLLIN;
+		}
+		if (!connection.output.empty()) {
+			events |= EPOLLOUT;
+		}
+		if (events == connection.events) {
+			return;
+		}
+		epoll_event event{};
+		event.events = events;
+		event.data.u64 = connection_id;
+		if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_MOD, connection.descriptor, &event) != 0) {
+			CloseConnection(connection_id);
+			return;
+		}
+		connection.events = events;
+	}
+
+	void Server::CloseConnection(uint64_t connection_id) {
+		auto position = connections_.find(connection_id);
+		if (position == connections_.end()) {
+			return;
+		}
+		// Закрытый дескриптор удаляется из epoll автоматически
+		CloseDescriptor(position->second.descriptor);
+		connections_.erase(position);
+		if (is_accept_paused_) {
+			ResumeAccepting();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "catalogue_store.h"
+#include "map_renderer.h"
+#include "profiler.h"
+#include "query_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace socket_server {
+
+	struct ServerSettings {
+		// Путь сокета Unix; существующий файл сокета по этому пути заменяется
+		std::string socket_path;
+		size_t workers_count = 4;
+		// Сколько рабочих потоков могут одновременно отвечать на тяжёлые запросы (Map, Update);
+		// остальные всегда свободны для лёгких. 0 - все потоки, кроме одного
+		size_t heavy_workers_limit = 0;
+		// Сколько запросов одного клиента может обрабатываться одновременно; дальше сервер
+		// перестаёт читать из его сокета, пока не отдаст ответы
+		size_t max_in_flight_per_connection = 1024;
+		// Наибольшая длина строки запроса; клиент, приславший более длинную строку, отключается
+		size_t max_request_size = 1 << 20;
+	};
+
+	// Сервер на сокете Unix: клиенты присылают запросы в формате элемента stat_requests по одному
+	// JSON-объекту в строке и получают по строке ответа на каждый в порядке запросов.
+	// Цикл epoll в потоке Run принимает соединения и передаёт строки запросов пулу рабочих потоков,
+	// которые отвечают по текущей версии справочника из общего хранилища. Запросы одного соединения
+	// обрабатываются параллельно, кроме Update: он начинается после ответов на все предыдущие запросы соединения,
+	// а следующие ждут его ответа, так что клиент видит справочник таким же, как при последовательной обработке.
+	// Запросы разных соединений друг друга не ждут, и чужой Update может стать виден между двумя ответами.
+	// Лёгкие и тяжёлые запросы (query_server::ClassifyRequestLine) ждут в разных очередях: свободный поток берёт
+	// сначала лёгкий запрос, а тяжёлые занимают не больше heavy_workers_limit потоков, поэтому поиск остановок
+	// и маршрутов не стоит в очереди за отрисовкой карты
+	class Server {
+	public:
+		Server(catalogue_store::CatalogueStore& store, const map_renderer::MapRender& map_renderer,
+		       ServerSettings settings, profiler::Profiler* profiler = nullptr);
+		~Server();
+
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// Обслуживает клиентов до вызова Stop; при ошибках сокета бросает std::system_error
+		void Run();
+
+		// Можно вызывать из любого потока и из обработчика сигнала
+		void Stop();
+
+	private:
+		struct Task {
+			uint64_t connection_id;
+			uint64_t sequence;
+			std::string request;
+			query_server::RequestClass request_class;
+			// Срок deadline_ms запроса отсчитывается от чтения его строки, так что ожидание в очереди входит в срок
+			deadline::Deadline::Clock::time_point received_at;
+		};
+
+		struct Connection {
+			int descriptor = -1;
+			std::string input;
+			std::string output;
+			uint64_t next_sequence = 0;
+			uint64_t next_sequence_to_write = 0;
+			// Готовые ответы, которые ждут ответов на более ранние запросы
+			std::map<uint64_t, std::string> ready_responses;
+			size_t in_flight = 0;
+			// Запросы, отданные рабочим потокам и ещё не отвеченные
+			size_t running_tasks = 0;
+			bool is_update_running = false;
+			// Запросы, которые ждут окончания Update, и сам Update, ждущий ответов на предыдущие
+			std::deque<Task> held_tasks;
+			bool is_peer_closed = false;
+			uint32_t events = 0;
+		};
+
+		struct Result {
+			uint64_t connection_id;
+			uint64_t sequence;
+			std::string response;
+		};
+
+		catalogue_store::CatalogueStore& store_;
+		const map_renderer::MapRender& map_renderer_;
+		ServerSettings settings_;
+		profiler::Profiler* profiler_;
+
+		int listen_descriptor_ = -1;
+		// Слушающий сокет снят с epoll, пока процессу не хватает дескрипторов для новых соединений
+		bool is_accept_paused_ = false;
+		int epoll_descriptor_ = -1;
+		// Будит цикл epoll, когда готовы ответы или запрошена остановка
+		int wakeup_descriptor_ = -1;
+		std::atomic<bool> is_stopping_{ false };
+
+		std::map<uint64_t, Connection> connections_;
+		uint64_t next_connection_id_;
+
+		std::mutex tasks_mutex_;
+		std::condition_variable tasks_condition_;
+		std::deque<Task> lookup_tasks_;
+		std::deque<Task> heavy_tasks_;
+		size_t heavy_workers_limit_;
+		size_t running_heavy_tasks_ = 0;
+		// Лёгкие запросы, выданные подряд, пока ждал тяжёлый: после LOOKUP_BURST таких тяжёлый идёт вне очереди
+		size_t lookups_since_heavy_ = 0;
+		bool is_tasks_closed_ = false;
+
+		std::mutex results_mutex_;
+		std::vector<Result> results_;
+
+		std::vector<std::thread> workers_;
+
+		void OpenSockets();
+		void CloseSockets();
+		void StartWorkers();
+		void StopWorkers();
+		void WorkerLoop();
+		bool HasRunnableTaskLocked() const;
+		Task PopTaskLocked();
+		void Wakeup();
+
+		void AcceptConnections();
+		// Снимает слушающий сокет с epoll, иначе цикл будет просыпаться на нём, не в силах принять соединение.
+		// Приём возобновляется, когда закрывается одно из соединений, а если соединений нет - через секунду
+		void PauseAccepting(int error_code);
+		void ResumeAccepting();
+		void HandleConnectionEvents(uint64_t connection_id, uint32_t events);
+		void HandleResults();
+
+		// Читает запросы из сокета; возвращает false, если строка запроса слишком длинна
+		bool ReadInput(uint64_t connection_id, Connection& connection);
+		// Передаёт рабочим потокам законченные строки запросов; возвращает false, если строка слишком длинна
+		bool ExtractRequests(uint64_t connection_id, Connection& connection);
+		// Добавляет задачи в очередь соединения и отдаёт рабочим потокам те, которых не задерживает Update
+		void ScheduleTasks(Connection& connection, std::vector<Task> tasks);
+		// Возвращает false при ошибке записи
+		bool WriteOutput(Connection& connection);
+		// Обновляет подписку epoll или закрывает соединение, если с ним всё закончено
+		void UpdateConnection(uint64_t connection_id, Connection& connection);
+		void CloseConnection(uint64_t connection_id);
+	};
+}
\ No newline at end of file
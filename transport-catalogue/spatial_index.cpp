@@ -0,0 +1,164 @@
+#define _USE_MATH_DEFINES
+#include "spatial_index.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace spatial_index {
+
+	namespace {
+		constexpr double DEGREES_TO_RADIANS = M_PI / 180.0;
+		// Ниже этого значения косинус широты не опускается, чтобы окрестность у полюсов оставалась конечной
+		constexpr double MIN_LATITUDE_COSINE = 1e-3;
+
+		double ComputeSegmentDistance(geo::Coordinates center, geo::Coordinates from, geo::Coordinates to) {
+			// Переходим к локальной равнопромежуточной проекции с началом в center (в метрах)
+			const double meters_per_degree = geo::EARTH_RADIUS * DEGREES_TO_RADIANS;
+			const double lng_scale = std::cos(center.lat * DEGREES_TO_RADIANS) * meters_per_degree;
+			const double from_x = (from.lng - center.lng) * lng_scale;
+			const double from_y = (from.lat - center.lat) * meters_per_degree;
+			const double to_x = (to.lng - center.lng) * lng_scale;
+			const double to_y = (to.lat - center.lat) * meters_per_degree;
+
+			const double dx = to_x - from_x;
+			const double dy = to_y - from_y;
+			const double squared_length = dx * dx + dy * dy;
+			double t = 0.0;
+			if (squared_length > 0.0) {
+				t = std::clamp(-(from_x * dx + from_y * dy) / squared_length, 0.0, 1.0);
+			}
+			return std::hypot(from_x + t * dx, from_y + t * dy);
+		}
+	}
+
+	void SegmentIndex::AddPolyline(size_t polyline_id, const std::vector<geo::Coordinates>& points) {
+		if (points.empty()) {
+			return;
+		}
+		if (polylines_boxes_.size() <= polyline_id) {
+			polylines_boxes_.resize(polyline_id + 1, { INFINITY, INFINITY, -INFINITY, -INFINITY });
+		}
+		BoundingBox& box = polylines_boxes_[polyline_id];
+		for (const auto& point : points) {
+			box.min_lat = std::min(box.min_lat, point.lat);
+			box.min_lng = std::min(box.min_lng, point.lng);
+			box.max_lat = std::max(box.max_lat, point.lat);
+			box.max_lng = std::max(box.max_lng, point.lng);
+		}
+		if (segments_.empty()) {
+			bounds_ = box;
+		}
+		else {
+			bounds_.min_lat = std::min(bounds_.min_lat, box.min_lat);
+			bounds_.min_lng = std::min(bounds_.min_lng, box.min_lng);
+			bounds_.max_lat = std::max(bounds_.max_lat, box.max_lat);
+			bounds_.max_lng = std::max(bounds_.max_lng, box.max_lng);
+		}
+
+		for (size_t i = 0; i == 0 || i + 1 < points.size(); ++i) {
+			const geo::Coordinates from = points[i];
+			const geo::Coordinates to = points.size() > 1 ? points[i + 1] : points[i];
+			const size_t segment_index = segments_.size();
+			segments_.push_back({ from, to, polyline_id });
+
+			// Отрезок раскладывается по ячейкам с шагом в половину ячейки,
+			// поэтому при поиске достаточно расширить окрестность на одну ячейку
+			const double length = std::max(std::abs(to.lat - from.lat), std::abs(to.lng - from.lng));
+			const size_t steps = static_cast<size_t>(std::ceil(2.0 * length / cell_size_));
+			uint64_t previous_key = 0;
+			for (size_t step = 0; step <= steps; ++step) {
+				const double t = steps == 0 ? 0.0 : static_cast<double>(step) / static_cast<double>(steps);
+				const uint64_t key = MakeCellKey(ToCell(from.lat + t * (to.lat - from.lat)),
+				                                 ToCell(from.lng + t * (to.lng - from.lng)));
+				if (step == 0 || key != previous_key) {
+					cells_[key].push_back(segment_index);
+					previous_key = key;
+				}
+			}
+		}
+	}
+
+	std::vector<size_t> SegmentIndex::FindPolylinesNear(geo::Coordinates center, double radius) const {
+		if (segments_.empty() || !std::isfinite(center.lat) || !std::isfinite(center.lng) || !(radius >= 0.0)) {
+			return {};
+		}
+		const double meters_per_degree = geo::EARTH_RADIUS * DEGREES_TO_RADIANS;
+		const double lat_delta = radius / meters_per_degree;
+		const double lng_delta = radius / (meters_per_degree
+			* std::max(std::cos(center.lat * DEGREES_TO_RADIANS), MIN_LATITUDE_COSINE));
+
+		std::vector<bool> is_checked(polylines_boxes_.size(), false);
+		std::vector<size_t> result;
+		auto check_segment = [&](const Segment& segment) {
+			if (is_checked[segment.polyline_id]) {
+				return;
+			}
+			const BoundingBox& box = polylines_boxes_[segment.polyline_id];
+			if (center.lat < box.min_lat - lat_delta || center.lat > box.max_lat + lat_delta
+				|| center.lng < box.min_lng - lng_delta || center.lng > box.max_lng + lng_delta) {
+				is_checked[segment.polyline_id] = true;
+				return;
+			}
+			if (ComputeSegmentDistance(center, segment.from, segment.to) <= radius) {
+				is_checked[segment.polyline_id] = true;
+				result.push_back(segment.polyline_id);
+			}
+		};
+
+		// Вне прямоугольника всех точек отрезков нет, а внутри него номера ячеек конечны и невелики
+		const double min_lat = std::max(center.lat - lat_delta, bounds_.min_lat);
+		const double max_lat = std::min(center.lat + lat_delta, bounds_.max_lat);
+		const double min_lng = std::max(center.lng - lng_delta, bounds_.min_lng);
+		const double max_lng = std::min(center.lng + lng_delta, bounds_.max_lng);
+		if (min_lat > max_lat || min_lng > max_lng) {
+			return {};
+		}
+		const int64_t min_lat_cell = ToCell(min_lat) - 1;
+		const int64_t max_lat_cell = ToCell(max_lat) + 1;
+		const int64_t min_lng_cell = ToCell(min_lng) - 1;
+		const int64_t max_lng_cell = ToCell(max_lng) + 1;
+		const double cells_count = static_cast<double>(max_lat_cell - min_lat_cell + 1)
+			* static_cast<double>(max_lng_cell - min_lng_cell + 1);
+
+		if (cells_count > static_cast<double>(cells_.size())) {
+			// Окрестность больше всей сетки: дешевле перебрать отрезки подряд
+			for (const Segment& segment : segments_) {
+				check_segment(segment);
+			}
+		}
+		else {
+			for (int64_t lat_cell = min_lat_cell; lat_cell <= max_lat_cell; ++lat_cell) {
+				for (int64_t lng_cell = min_lng_cell; lng_cell <= max_lng_cell; ++lng_cell) {
+					const auto cell_it = cells_.find(MakeCellKey(lat_cell, lng_cell));
+					if (cell_it == cells_.end()) {
+						continue;
+					}
+					for (size_t segment_index : cell_it->second) {
+						check_segment(segments_[segment_index]);
+					}
+				}
+			}
+		}
+
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	int64_t SegmentIndex::ToCell(double degrees) const {
+		return static_cast<int64_t>(std::floor(degrees / cell_size_));
+	}
+
+	uint64_t SegmentIndex::MakeCellKey(int64_t lat_cell, int64_t lng_cell) const {
+		return (static_cast<uint64_t>(lat_cell) << 32) ^ static_cast<uint64_t>(static_cast<uint32_t>(lng_cell));
+	}
+
+	size_t SegmentIndex::MemoryUsage() const {
+		size_t bytes = memory_usage::GetHeapBytes(segments_) + memory_usage::GetHeapBytes(polylines_boxes_)
+		             + memory_usage::GetHeapBytes(cells_);
+		for (const auto& [key, cell_segments] : cells_) {
+			bytes += memory_usage::GetHeapBytes(cell_segments);
+		}
+		return bytes;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "geo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace spatial_index {
+
+	struct BoundingBox {
+		double min_lat = 0.0;
+		double min_lng = 0.0;
+		double max_lat = 0.0;
+		double max_lng = 0.0;
+	};
+
+	// Пространственный индекс отрезков ломаных на равномерной сетке в градусах.
+	// Каждая ячейка хранит отрезки, проходящие через неё, каждая ломаная - свой охватывающий прямоугольник
+	class SegmentIndex {
+	public:
+		explicit SegmentIndex(double cell_size = 0.005)
+			:cell_size_(cell_size)
+		{
+		}
+
+		void AddPolyline(size_t polyline_id, const std::vector<geo::Coordinates>& points);
+
+		// Возвращает упорядоченные идентификаторы ломаных, проходящих не дальше radius метров от точки.
+		// Для нечисловых координат и отрицательного или нечислового радиуса возвращает пустой список;
+		// бесконечный радиус охватывает все ломаные
+		std::vector<size_t> FindPolylinesNear(geo::Coordinates center, double radius) const;
+
+		// Оценка памяти, занятой отрезками, прямоугольниками и ячейками, в байтах
+		size_t MemoryUsage() const;
+
+	private:
+		struct Segment {
+			geo::Coordinates from;
+			geo::Coordinates to;
+			size_t polyline_id;
+		};
+
+		double cell_size_;
+		std::vector<Segment> segments_;
+		std::vector<BoundingBox> polylines_boxes_;
+		// Прямоугольник всех точек индекса: окрестность поиска обрезается по нему, так что номера ячеек
+		// остаются в пределах сетки при любом радиусе
+		BoundingBox bounds_;
+		std::unordered_map<uint64_t, std::vector<size_t>> cells_;
+
+		int64_t ToCell(double degrees) const;
+		uint64_t MakeCellKey(int64_t lat_cell, int64_t lng_cell) const;
+	};
+}
\ No newline at end of file
@@ -1,19 +1,42 @@
 #include "transport_catalogue.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <bitset>
 #include <stdexcept>
 
 namespace transport_catalogue {
 
 	using namespace domain;
 
+	namespace {
+		constexpr size_t BITMAP_WORD_SIZE = 64;
+
+		int CountTrailingZeros(uint64_t word) {
+			return static_cast<int>(std::bitset<BITMAP_WORD_SIZE>((word & (~word + 1)) - 1).count());
+		}
+
+		bool HasCommonBuses(const BusesBitmap& lhs, const BusesBitmap& rhs) {
+			const size_t words_count = std::min(lhs.size(), rhs.size());
+			for (size_t i = 0; i < words_count; ++i) {
+				if ((lhs[i] & rhs[i]) != 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
 	size_t PairStopsHasher::operator()(const std::pair<const Stop*, const Stop*> stops) const {
 		return hasher_(stops.first) + 53 * hasher_(stops.second);
 	}
 
 	void TransportCatalogue::AddStop(std::string stop_name, geo::Coordinates stop_coordinates) {
-		Stop temp_stop_object = { std::move(stop_name), std::move(stop_coordinates) };
+		Stop temp_stop_object = { std::move(stop_name), std::move(stop_coordinates), stops_.size() };
 		Stop const& stop = stops_.emplace_back(std::move(temp_stop_object));
 		stopname_to_stop_[static_cast<std::string_view>(stops_.back().stop_name)] = &stop;
+		buses_bitmap_for_stop_.emplace_back((buses_.size() + BITMAP_WORD_SIZE - 1) / BITMAP_WORD_SIZE, 0);
+		prepared_coordinates_.push_back(geo::PrepareCoordinates(stop.stop_coordinates));
 	}
 
 	void TransportCatalogue::AddBus(std::string bus_name, 
@@ -33,11 +56,112 @@ namespace transport_catalogue {
 
 		Bus temp_bus_object = { std::move(bus_name),
 								std::move(input_stops),
-								is_roundtrip };
+								is_roundtrip,
+								buses_.size() };
 		Bus const& bus = buses_.emplace_back(std::move(temp_bus_object));
 		busname_to_bus_[static_cast<std::string_view>(buses_.back().bus_name)] = &bus;
+		const size_t word_index = bus.bus_id / BITMAP_WORD_SIZE;
+		const uint64_t bus_bit = uint64_t{ 1 } << (bus.bus_id % BITMAP_WORD_SIZE);
 		for (auto const& stop : buses_.back().bus_stops) {
 			buses_for_stopname_[stop->stop_name].insert(buses_.back().bus_name);
+			BusesBitmap& stop_bitmap = buses_bitmap_for_stop_[stop->stop_id];
+			if (stop_bitmap.size() <= word_index) {
+				stop_bitmap.resize(word_index + 1, 0);
+			}
+			stop_bitmap[word_index] |= bus_bit;
+		}
+	}
+
+	void TransportCatalogue::AddStops(const std::vector<StopRecord>& stops, size_t threads_count) {
+		std::vector<geo::PreparedCoordinates> prepared_coordinates(stops.size());
+		parallel::ForEachChunk(stops.size(), threads_count, [&](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				prepared_coordinates[i] = geo::PrepareCoordinates(stops[i].coordinates);
+			}
+		});
+
+		stopname_to_stop_.reserve(stopname_to_stop_.size() + stops.size());
+		buses_bitmap_for_stop_.reserve(buses_bitmap_for_stop_.size() + stops.size());
+		prepared_coordinates_.reserve(prepared_coordinates_.size() + stops.size());
+		const size_t bitmap_words_count = (buses_.size() + BITMAP_WORD_SIZE - 1) / BITMAP_WORD_SIZE;
+		for (size_t i = 0; i < stops.size(); ++i) {
+			Stop const& stop = stops_.emplace_back(Stop{ std::string(stops[i].name), stops[i].coordinates, stops_.size() });
+			stopname_to_stop_[static_cast<std::string_view>(stop.stop_name)] = &stop;
+			buses_bitmap_for_stop_.emplace_back(bitmap_words_count, 0);
+			prepared_coordinates_.push_back(prepared_coordinates[i]);
+		}
+	}
+
+	void TransportCatalogue::AddBuses(const std::vector<BusRecord>& buses, size_t threads_count) {
+		std::vector<std::vector<const Stop*>> buses_stops(buses.size());
+		parallel::ForEachChunk(buses.size(), threads_count, [&](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				buses_stops[i].reserve(buses[i].stops.size());
+				for (std::string_view stop_name : buses[i].stops) {
+					const auto position = stopname_to_stop_.find(stop_name);
+					if (position == stopname_to_stop_.end()) {
+						throw std::out_of_range(std::string{ "There is not stop in data base" });
+					}
+					buses_stops[i].push_back(position->second);
+				}
+			}
+		});
+
+		const size_t first_bus_id = buses_.size();
+		busname_to_bus_.reserve(busname_to_bus_.size() + buses.size());
+		// Ключи списков маршрутов вставляются заранее: потоки ниже меняют только значения
+		// при разных ключах, что для unordered_map безопасно
+		std::vector<bool> is_stop_listed(stops_.size(), false);
+		for (size_t i = 0; i < buses.size(); ++i) {
+			Bus const& bus = buses_.emplace_back(Bus{ std::string(buses[i].name), std::move(buses_stops[i]),
+			                                          buses[i].is_roundtrip, buses_.size() });
+			busname_to_bus_[static_cast<std::string_view>(bus.bus_name)] = &bus;
+			for (const Stop* stop : bus.bus_stops) {
+				if (!is_stop_listed[stop->stop_id]) {
+					is_stop_listed[stop->stop_id] = true;
+					buses_for_stopname_.try_emplace(stop->stop_name);
+				}
+			}
+		}
+
+		// Каждый поток отвечает за свой диапазон остановок и просматривает все новые маршруты
+		const size_t stops_count = stops_.size();
+		parallel::ForEachChunk(stops_count, threads_count, [&](size_t, size_t stops_begin, size_t stops_end) {
+			if (stops_begin == stops_end) {
+				return;
+			}
+			for (size_t bus_id = first_bus_id; bus_id < buses_.size(); ++bus_id) {
+				const Bus& bus = buses_[bus_id];
+				const size_t word_index = bus_id / BITMAP_WORD_SIZE;
+				const uint64_t bus_bit = uint64_t{ 1 } << (bus_id % BITMAP_WORD_SIZE);
+				for (const Stop* stop : bus.bus_stops) {
+					if (stop->stop_id < stops_begin || stop->stop_id >= stops_end) {
+						continue;
+					}
+					buses_for_stopname_.find(stop->stop_name)->second.insert(bus.bus_name);
+					BusesBitmap& stop_bitmap = buses_bitmap_for_stop_[stop->stop_id];
+					if (stop_bitmap.size() <= word_index) {
+						stop_bitmap.resize(word_index + 1, 0);
+					}
+					stop_bitmap[word_index] |= bus_bit;
+				}
+			}
+		});
+	}
+
+	void TransportCatalogue::AddDistances(const std::vector<DistanceRecord>& distances, size_t threads_count) {
+		std::vector<std::pair<const Stop*, const Stop*>> distances_stops(distances.size());
+		parallel::ForEachChunk(distances.size(), threads_count, [&](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				distances_stops[i] = { FindStop(distances[i].from_stop), FindStop(distances[i].to_stop) };
+			}
+		});
+
+		distances_between_stops_.reserve(distances_between_stops_.size() + distances.size());
+		for (size_t i = 0; i < distances.size(); ++i) {
+			if (distances_stops[i].first != nullptr && distances_stops[i].second != nullptr) {
+				distances_between_stops_[distances_stops[i]] = distances[i].distance;
+			}
 		}
 	}
 
@@ -59,47 +183,258 @@ namespace transport_catalogue {
 		}
 	}
 
-	Bus_Information TransportCatalogue::GetBusInformation(const Bus* bus_iterator) const {
-		int bus_stops = 0;
-		bus_iterator->is_roundtrip ? bus_stops = static_cast<int>(bus_iterator->bus_stops.size()) :
-			                         bus_stops = (static_cast<int>(bus_iterator->bus_stops.size())) * 2 - 1;
-		std::unordered_set<std::string_view> unique_bus_stops;
-		int bus_route_length = 0;
-		double geografical_bus_route_length = 0;
-		const Stop* from_stop = bus_iterator->bus_stops[0];
-		bool the_fist_stop = true;
-
-		for (auto const& bus_stop : bus_iterator->bus_stops) {
-			unique_bus_stops.insert(bus_stop->stop_name);
-			if (the_fist_stop) {
-				the_fist_stop = false;
+	void TransportCatalogue::SetDistanceModel(geo::DistanceModel distance_model) {
+		distance_model_ = distance_model;
+	}
+
+	geo::DistanceModel TransportCatalogue::GetDistanceModel() const {
+		return distance_model_;
+	}
+
+	void TransportCatalogue::BuildIndexes() {
+		BuildIndexes(std::vector<const RouteLengths*>(buses_.size(), nullptr), true);
+	}
+
+	size_t TransportCatalogue::BuildIndexes(const TransportCatalogue& previous, const CatalogueChanges& changes) {
+		std::vector<bool> is_bus_affected(buses_.size(), distance_model_ != previous.distance_model_);
+		auto mark_buses = [&is_bus_affected](const BusesBitmap& bitmap) {
+			for (size_t i = 0; i < bitmap.size(); ++i) {
+				for (uint64_t word = bitmap[i]; word != 0; word &= word - 1) {
+					is_bus_affected[i * BITMAP_WORD_SIZE + CountTrailingZeros(word)] = true;
+				}
+			}
+		};
+		for (std::string_view stop_name : changes.moved_stops) {
+			if (const Stop* stop = FindStop(stop_name)) {
+				mark_buses(buses_bitmap_for_stop_[stop->stop_id]);
+			}
+		}
+		// Расстояние нужно маршрутам, проходящим через обе остановки; среди них могут быть и маршруты,
+		// где остановки не соседние, - их лишний пересчёт дешевле точного поиска пары на маршруте
+		for (const auto& [from_name, to_name] : changes.changed_distances) {
+			const Stop* from_stop = FindStop(from_name);
+			const Stop* to_stop = FindStop(to_name);
+			if (from_stop == nullptr || to_stop == nullptr) {
+				continue;
+			}
+			const BusesBitmap& from_bitmap = buses_bitmap_for_stop_[from_stop->stop_id];
+			const BusesBitmap& to_bitmap = buses_bitmap_for_stop_[to_stop->stop_id];
+			BusesBitmap common_bitmap(std::min(from_bitmap.size(), to_bitmap.size()));
+			for (size_t i = 0; i < common_bitmap.size(); ++i) {
+				common_bitmap[i] = from_bitmap[i] & to_bitmap[i];
+			}
+			mark_buses(common_bitmap);
+		}
+
+		std::vector<const RouteLengths*> reusable_lengths(buses_.size(), nullptr);
+		size_t recomputed_count = 0;
+		for (const Bus& bus : buses_) {
+			const Bus* previous_bus = previous.FindBus(bus.bus_name);
+			if (is_bus_affected[bus.bus_id] || previous_bus == nullptr || changes.changed_buses.count(bus.bus_name) > 0
+			    || previous_bus->bus_id >= previous.routes_lengths_.size()) {
+				++recomputed_count;
+				continue;
+			}
+			reusable_lengths[bus.bus_id] = &previous.routes_lengths_[previous_bus->bus_id];
+		}
+		BuildIndexes(reusable_lengths, !changes.are_stops_removed);
+		return recomputed_count;
+	}
+
+	void TransportCatalogue::BuildIndexes(const std::vector<const RouteLengths*>& reusable_lengths, bool are_stop_ids_kept) {
+		routes_lengths_.clear();
+		routes_lengths_.reserve(buses_.size());
+		buses_segments_index_ = spatial_index::SegmentIndex{};
+
+		std::vector<search_index::NameEntry> names;
+		names.reserve(stops_.size() + buses_.size());
+		for (const Stop& stop : stops_) {
+			names.push_back({ stop.stop_name, search_index::NameKind::STOP });
+		}
+		for (const Bus& bus : buses_) {
+			names.push_back({ bus.bus_name, search_index::NameKind::BUS });
+		}
+		names_index_ = search_index::NameIndex{ std::move(names) };
+
+		for (const Bus& bus : buses_) {
+			std::vector<geo::Coordinates> bus_polyline;
+			bus_polyline.reserve(bus.bus_stops.size());
+			for (const Stop* stop : bus.bus_stops) {
+				bus_polyline.push_back(stop->stop_coordinates);
+			}
+			buses_segments_index_.AddPolyline(bus.bus_id, bus_polyline);
+
+			const RouteLengths* reusable = reusable_lengths[bus.bus_id];
+			if (reusable == nullptr) {
+				routes_lengths_.push_back(ComputeRouteLengths(bus));
+				continue;
+			}
+			RouteLengths& route_lengths = routes_lengths_.emplace_back(*reusable);
+			if (!are_stop_ids_kept) {
+				// Длины не зависят от номеров остановок, а позиции достаточно перенумеровать
+				const size_t stops_count = bus.bus_stops.size();
+				for (auto& [stop_id, position] : route_lengths.stop_positions) {
+					const size_t stop_index = position < stops_count ? position : 2 * (stops_count - 1) - position;
+					stop_id = bus.bus_stops[stop_index]->stop_id;
+				}
+				std::sort(route_lengths.stop_positions.begin(), route_lengths.stop_positions.end());
+			}
+		}
+	}
+
+	RouteLengths TransportCatalogue::ComputeRouteLengths(const Bus& bus) const {
+		// Географические длины отрезков считаются пакетом по заранее вычисленной тригонометрии остановок;
+		// обратный путь некольцевого маршрута проходит те же отрезки в обратном порядке
+		std::vector<geo::PreparedCoordinates> prepared_polyline;
+		prepared_polyline.reserve(bus.bus_stops.size());
+		for (const Stop* stop : bus.bus_stops) {
+			prepared_polyline.push_back(prepared_coordinates_[stop->stop_id]);
+		}
+		const std::vector<double> segments_lengths = geo::ComputeDistancesAlong(prepared_polyline, distance_model_);
+
+		std::vector<const Stop*> route_stops = bus.bus_stops;
+		if (!bus.is_roundtrip) {
+			route_stops.insert(route_stops.end(), bus.bus_stops.rbegin() + 1, bus.bus_stops.rend());
+		}
+
+		RouteLengths route_lengths;
+		route_lengths.road_lengths.reserve(route_stops.size());
+		route_lengths.geografical_lengths.reserve(route_stops.size());
+		route_lengths.stop_positions.reserve(route_stops.size());
+		for (size_t i = 0; i < route_stops.size(); ++i) {
+			if (i == 0) {
+				route_lengths.road_lengths.push_back(0);
+				route_lengths.geografical_lengths.push_back(0.0);
 			}
 			else {
-				bus_route_length += GetDistanceBetweenStops(from_stop, bus_stop);
-				geografical_bus_route_length += geo::ComputeDistance(from_stop->stop_coordinates,
-					                                                 bus_stop->stop_coordinates);
-				from_stop = bus_stop;
+				const std::optional<int> distance = GetDistanceBetweenStops(route_stops[i - 1], route_stops[i]);
+				if (!distance) {
+					route_lengths = RouteLengths{};
+					route_lengths.missing_distance = std::string{ "Road distance between stops " }
+						+ route_stops[i - 1]->stop_name + " and " + route_stops[i]->stop_name
+						+ " of bus " + bus.bus_name + " is missing";
+					return route_lengths;
+				}
+				route_lengths.road_lengths.push_back(route_lengths.road_lengths.back() + *distance);
+				const size_t segment_index = i < bus.bus_stops.size() ? i - 1 : 2 * (bus.bus_stops.size() - 1) - i;
+				route_lengths.geografical_lengths.push_back(route_lengths.geografical_lengths.back()
+					+ segments_lengths[segment_index]);
 			}
+			route_lengths.stop_positions.emplace_back(route_stops[i]->stop_id, i);
 		}
+		std::sort(route_lengths.stop_positions.begin(), route_lengths.stop_positions.end());
 
-		if (!bus_iterator->is_roundtrip) {
-			for (auto it = bus_iterator->bus_stops.rbegin() + 1 ; it != bus_iterator->bus_stops.rend(); it++) {
-				const Stop* bus_stop = *it;
-				bus_route_length += GetDistanceBetweenStops(from_stop, bus_stop);
-				geografical_bus_route_length += geo::ComputeDistance(from_stop->stop_coordinates,
-					                                                 bus_stop->stop_coordinates);
-				from_stop = bus_stop;
+		for (size_t i = 0; i < route_lengths.stop_positions.size(); ++i) {
+			if (i == 0 || route_lengths.stop_positions[i].first != route_lengths.stop_positions[i - 1].first) {
+				++route_lengths.unique_bus_stops;
 			}
 		}
+		return route_lengths;
+	}
+
+	const RouteLengths& TransportCatalogue::GetRouteLengths(const Bus* bus_iterator) const {
+		if (bus_iterator->bus_id >= routes_lengths_.size()) {
+			throw std::logic_error(std::string{ "Indexes are not built" });
+		}
+		const RouteLengths& route_lengths = routes_lengths_[bus_iterator->bus_id];
+		if (!route_lengths.missing_distance.empty()) {
+			throw std::out_of_range(route_lengths.missing_distance);
+		}
+		return route_lengths;
+	}
+
+	void TransportCatalogue::CheckRouteLengths(const TransportCatalogue& previous) const {
+		for (const Bus& bus : buses_) {
+			if (routes_lengths_[bus.bus_id].missing_distance.empty()) {
+				continue;
+			}
+			const Bus* previous_bus = previous.FindBus(bus.bus_name);
+			if (previous_bus == nullptr || previous.routes_lengths_[previous_bus->bus_id].missing_distance.empty()) {
+				throw std::out_of_range(routes_lengths_[bus.bus_id].missing_distance);
+			}
+		}
+	}
+
+	Bus_Information TransportCatalogue::GetBusInformation(const Bus* bus_iterator) const {
+		const RouteLengths& route_lengths = GetRouteLengths(bus_iterator);
+		const int bus_route_length = route_lengths.road_lengths.back();
+		const double geografical_bus_route_length = route_lengths.geografical_lengths.back();
 
 		return { bus_iterator->bus_name,
-			     bus_stops,
-				 static_cast<int>(unique_bus_stops.size()),
+			     static_cast<int>(route_lengths.road_lengths.size()),
+				 route_lengths.unique_bus_stops,
 				 bus_route_length,
 				 geografical_bus_route_length,
 				 static_cast<double>(bus_route_length) / geografical_bus_route_length };
 	}
 
+	std::vector<search_index::SearchResult> TransportCatalogue::SearchNames(std::string_view query, int max_errors,
+		                                                                    bool is_prefix, size_t limit) const {
+		return names_index_.Search(query, max_errors, is_prefix, limit);
+	}
+
+	std::vector<std::string_view> TransportCatalogue::GetBusesNearPoint(geo::Coordinates point, double radius) const {
+		std::vector<std::string_view> buses;
+		for (size_t bus_id : buses_segments_index_.FindPolylinesNear(point, radius)) {
+			buses.push_back(buses_[bus_id].bus_name);
+		}
+		std::sort(buses.begin(), buses.end());
+		return buses;
+	}
+
+	std::optional<Route_Segment_Information> TransportCatalogue::GetDistanceAlongBus(const Bus* bus_iterator,
+		                                                                            const Stop* from_stop,
+		                                                                            const Stop* to_stop) const {
+		const RouteLengths& route_lengths = GetRouteLengths(bus_iterator);
+		const auto& positions = route_lengths.stop_positions;
+		const auto [from_begin, from_end] = std::equal_range(positions.begin(), positions.end(),
+			std::pair{ from_stop->stop_id, size_t{ 0 } },
+			[](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+		const auto [to_begin, to_end] = std::equal_range(positions.begin(), positions.end(),
+			std::pair{ to_stop->stop_id, size_t{ 0 } },
+			[](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+		if (from_begin == from_end || to_begin == to_end) {
+			return std::nullopt;
+		}
+		if (from_stop == to_stop) {
+			return Route_Segment_Information{ 0, 0.0, 0 };
+		}
+
+		// Маршрут замкнут, если последняя остановка совпадает с первой:
+		// тогда после конечной автобус продолжает движение с начала маршрута
+		const size_t last_position = route_lengths.road_lengths.size() - 1;
+		const bool is_closed_route = !bus_iterator->is_roundtrip
+			|| bus_iterator->bus_stops.front() == bus_iterator->bus_stops.back();
+		std::optional<Route_Segment_Information> result;
+		for (auto from_it = from_begin; from_it != from_end; ++from_it) {
+			const size_t from_position = from_it->second;
+			auto to_it = std::upper_bound(to_begin, to_end, from_position,
+				[](size_t position, const auto& stop_position) { return position < stop_position.second; });
+			Route_Segment_Information candidate;
+			if (to_it != to_end) {
+				const size_t to_position = to_it->second;
+				candidate = { route_lengths.road_lengths[to_position] - route_lengths.road_lengths[from_position],
+					          route_lengths.geografical_lengths[to_position] - route_lengths.geografical_lengths[from_position],
+					          static_cast<int>(to_position - from_position) };
+			}
+			else if (is_closed_route) {
+				const size_t to_position = to_begin->second;
+				candidate = { route_lengths.road_lengths[last_position] - route_lengths.road_lengths[from_position]
+					              + route_lengths.road_lengths[to_position],
+					          route_lengths.geografical_lengths[last_position] - route_lengths.geografical_lengths[from_position]
+					              + route_lengths.geografical_lengths[to_position],
+					          static_cast<int>(last_position - from_position + to_position) };
+			}
+			else {
+				continue;
+			}
+			if (!result || candidate.route_length < result->route_length) {
+				result = candidate;
+			}
+		}
+		return result;
+	}
+
 	std::set<std::string_view> TransportCatalogue::GetBusesForStop(std::string_view stop_name) const {
 		if (buses_for_stopname_.find(stop_name) != buses_for_stopname_.end()) {
 			return buses_for_stopname_.at(stop_name);
@@ -109,6 +444,50 @@ namespace transport_catalogue {
 		}
 	}
 
+	Transfers_Information TransportCatalogue::GetTransfersBetweenStops(const Stop* from_stop,
+		                                                               const Stop* to_stop) const {
+		const BusesBitmap& from_bitmap = buses_bitmap_for_stop_[from_stop->stop_id];
+		const BusesBitmap& to_bitmap = buses_bitmap_for_stop_[to_stop->stop_id];
+		Transfers_Information transfers_information;
+
+		const size_t common_words_count = std::min(from_bitmap.size(), to_bitmap.size());
+		size_t direct_buses_count = 0;
+		for (size_t i = 0; i < common_words_count; ++i) {
+			direct_buses_count += std::bitset<BITMAP_WORD_SIZE>(from_bitmap[i] & to_bitmap[i]).count();
+		}
+		transfers_information.direct_buses.reserve(direct_buses_count);
+		for (size_t i = 0; i < common_words_count; ++i) {
+			for (uint64_t word = from_bitmap[i] & to_bitmap[i]; word != 0; word &= word - 1) {
+				const size_t bus_id = i * BITMAP_WORD_SIZE + CountTrailingZeros(word);
+				transfers_information.direct_buses.push_back(buses_[bus_id].bus_name);
+			}
+		}
+
+		// Пересадка возможна на любой остановке маршрутов первой остановки,
+		// через которую проходит хотя бы один маршрут второй остановки
+		std::vector<bool> visited_stops(stops_.size(), false);
+		visited_stops[from_stop->stop_id] = true;
+		visited_stops[to_stop->stop_id] = true;
+		for (size_t i = 0; i < from_bitmap.size(); ++i) {
+			for (uint64_t word = from_bitmap[i]; word != 0; word &= word - 1) {
+				const size_t bus_id = i * BITMAP_WORD_SIZE + CountTrailingZeros(word);
+				for (const Stop* stop : buses_[bus_id].bus_stops) {
+					if (visited_stops[stop->stop_id]) {
+						continue;
+					}
+					visited_stops[stop->stop_id] = true;
+					if (HasCommonBuses(buses_bitmap_for_stop_[stop->stop_id], to_bitmap)) {
+						transfers_information.transfer_stops.push_back(stop->stop_name);
+					}
+				}
+			}
+		}
+
+		std::sort(transfers_information.direct_buses.begin(), transfers_information.direct_buses.end());
+		std::sort(transfers_information.transfer_stops.begin(), transfers_information.transfer_stops.end());
+		return transfers_information;
+	}
+
 	void TransportCatalogue::AddDistanceBetweenStops(const std::string& stop,
 		const DistancesContainer& distances_container) {
 		if (distances_container.size() == 0) {
@@ -117,17 +496,28 @@ namespace transport_catalogue {
 
 		const Stop* from_stop = FindStop(stop);
 
+		if (from_stop == nullptr) {
+			return;
+		}
 		for (const auto& [distance_between_stops, destination] : distances_container) {
-			const Stop* to_stop = FindStop(destination);
-			distances_between_stops_[{from_stop, to_stop}] = distance_between_stops;
+			if (const Stop* to_stop = FindStop(destination)) {
+				SetDistanceBetweenStops(from_stop, to_stop, distance_between_stops);
+			}
 		}
 	}
 
-	int TransportCatalogue::GetDistanceBetweenStops(const Stop* from_stop, const Stop* to_stop) const {
-		std::pair<const Stop*, const Stop*> stops = { from_stop, to_stop };
-		std::pair<const Stop*, const Stop*> inverse_stops = { to_stop, from_stop };
-		return distances_between_stops_.count(stops) ? distances_between_stops_.at(stops) :
-			distances_between_stops_.at(inverse_stops);
+	void TransportCatalogue::SetDistanceBetweenStops(const Stop* from_stop, const Stop* to_stop, int distance) {
+		distances_between_stops_[{from_stop, to_stop}] = distance;
+	}
+
+	std::optional<int> TransportCatalogue::GetDistanceBetweenStops(const Stop* from_stop, const Stop* to_stop) const {
+		if (const auto it = distances_between_stops_.find({ from_stop, to_stop }); it != distances_between_stops_.end()) {
+			return it->second;
+		}
+		if (const auto it = distances_between_stops_.find({ to_stop, from_stop }); it != distances_between_stops_.end()) {
+			return it->second;
+		}
+		return std::nullopt;
 	}
 
 	const std::unordered_map<std::string_view, const domain::Bus*>& TransportCatalogue::GetBuses() const {
@@ -137,4 +527,67 @@ namespace transport_catalogue {
 	const std::unordered_map<std::string_view, const domain::Stop*>& TransportCatalogue::GetStops() const {
 		return stopname_to_stop_;
 	}
+
+	const std::deque<domain::Stop>& TransportCatalogue::GetStopsList() const {
+		return stops_;
+	}
+
+	const std::deque<domain::Bus>& TransportCatalogue::GetBusesList() const {
+		return buses_;
+	}
+
+	const DistancesMap& TransportCatalogue::GetDistances() const {
+		return distances_between_stops_;
+	}
+
+	memory_usage::Report TransportCatalogue::MemoryUsage() const {
+		memory_usage::Report report;
+
+		size_t stops_bytes = memory_usage::GetHeapBytes(stops_);
+		for (const auto& stop : stops_) {
+			stops_bytes += memory_usage::GetHeapBytes(stop.stop_name);
+		}
+		report.Add("stops_", stops_.size(), stops_bytes);
+
+		size_t buses_bytes = memory_usage::GetHeapBytes(buses_);
+		for (const auto& bus : buses_) {
+			buses_bytes += memory_usage::GetHeapBytes(bus.bus_name) + memory_usage::GetHeapBytes(bus.bus_stops);
+		}
+		report.Add("buses_", buses_.size(), buses_bytes);
+
+		report.Add("stopname_to_stop_", stopname_to_stop_.size(), memory_usage::GetHeapBytes(stopname_to_stop_));
+		report.Add("busname_to_bus_", busname_to_bus_.size(), memory_usage::GetHeapBytes(busname_to_bus_));
+
+		size_t buses_for_stopname_bytes = memory_usage::GetHeapBytes(buses_for_stopname_);
+		for (const auto& [stop_name, buses] : buses_for_stopname_) {
+			buses_for_stopname_bytes += memory_usage::GetHeapBytes(buses);
+		}
+		report.Add("buses_for_stopname_", buses_for_stopname_.size(), buses_for_stopname_bytes);
+
+		report.Add("distances_between_stops_", distances_between_stops_.size(),
+		           memory_usage::GetHeapBytes(distances_between_stops_));
+
+		size_t bitmaps_bytes = memory_usage::GetHeapBytes(buses_bitmap_for_stop_);
+		for (const auto& bitmap : buses_bitmap_for_stop_) {
+			bitmaps_bytes += memory_usage::GetHeapBytes(bitmap);
+		}
+		report.Add("buses_bitmap_for_stop_", buses_bitmap_for_stop_.size(), bitmaps_bytes);
+
+		report.Add("prepared_coordinates_", prepared_coordinates_.size(),
+		           memory_usage::GetHeapBytes(prepared_coordinates_));
+
+		size_t routes_lengths_bytes = memory_usage::GetHeapBytes(routes_lengths_);
+		for (const auto& route_lengths : routes_lengths_) {
+			routes_lengths_bytes += memory_usage::GetHeapBytes(route_lengths.road_lengths)
+			                      + memory_usage::GetHeapBytes(route_lengths.geografical_lengths)
+			                      + memory_usage::GetHeapBytes(route_lengths.stop_positions)
+			                      + memory_usage::GetHeapBytes(route_lengths.missing_distance);
+		}
+		report.Add("routes_lengths_", routes_lengths_.size(), routes_lengths_bytes);
+
+		report.Add("buses_segments_index_", buses_.size(), buses_segments_index_.MemoryUsage());
+		report.Add("names_index_", stops_.size() + buses_.size(), names_index_.MemoryUsage());
+
+		return report;
+	}
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
@@ -9,11 +11,30 @@
 #include <vector>
 
 #include "domain.h"
+#include "memory_usage.h"
+#include "search_index.h"
+#include "spatial_index.h"
 
 namespace transport_catalogue {
 
 	using DistancesContainer = std::vector<std::pair<int, std::string_view>>;
 
+	// Битовая маска маршрутов: бит с номером bus_id установлен, если маршрут проходит через остановку
+	using BusesBitmap = std::vector<uint64_t>;
+
+	// Накопленные длины маршрута: i-й элемент содержит длину пути от первой остановки
+	// до i-й остановки маршрута (для некольцевого маршрута учитывается и обратный путь)
+	struct RouteLengths {
+		std::vector<int> road_lengths;
+		std::vector<double> geografical_lengths;
+		// Пары (stop_id, позиция остановки на маршруте), упорядоченные по возрастанию
+		std::vector<std::pair<size_t, size_t>> stop_positions;
+		int unique_bus_stops = 0;
+		// Непусто, если между соседними остановками маршрута нет расстояния: длины не посчитаны,
+		// и запросы о маршруте получают это сообщение как ошибку, а остальные маршруты отвечаются как обычно
+		std::string missing_distance;
+	};
+
 	struct PairStopsHasher {
 	public:
 		size_t operator()(const std::pair<const domain::Stop*, const domain::Stop*> stops) const;
@@ -21,34 +42,150 @@ namespace transport_catalogue {
 		std::hash<const void*> hasher_;
 	};
 
+	using DistancesMap = std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, PairStopsHasher>;
+
+	// Записи base_requests для пакетной загрузки; названия должны жить до конца загрузки
+	struct StopRecord {
+		std::string_view name;
+		geo::Coordinates coordinates;
+	};
+
+	struct BusRecord {
+		std::string_view name;
+		std::vector<std::string_view> stops;
+		bool is_roundtrip = false;
+	};
+
+	struct DistanceRecord {
+		std::string_view from_stop;
+		std::string_view to_stop;
+		int distance = 0;
+	};
+
+	// Отличия справочника от предыдущей версии, по которым видно, чьи длины маршрутов пересчитывать
+	struct CatalogueChanges {
+		// Остановки, у которых изменились координаты
+		std::unordered_set<std::string_view> moved_stops;
+		// Пары остановок, расстояние между которыми задано заново или удалено
+		std::vector<std::pair<std::string_view, std::string_view>> changed_distances;
+		// Добавленные и заменённые маршруты
+		std::unordered_set<std::string_view> changed_buses;
+		// Удалялись ли остановки: тогда номера остановок после удалённой сдвигаются
+		bool are_stops_removed = false;
+	};
+
 	class TransportCatalogue {
 	public:
 		void AddStop(std::string stop_name, geo::Coordinates stop_coordinates);
 
 		void AddBus(std::string bus_name, std::vector<std::string_view> const& bus_stops, bool is_roundtrip);
 
+		// Пакетные версии AddStop, AddBus и AddDistanceBetweenStops с тем же результатом, что и добавление
+		// записей по одной в том же порядке. Независимая работа - тригонометрия координат, поиск остановок
+		// по названиям, заполнение матрицы "остановка × маршрут" и списков маршрутов остановок по
+		// непересекающимся диапазонам остановок - делится между threads_count потоками;
+		// вставка в общие хеш-таблицы идёт в вызывающем потоке после резервирования места
+		void AddStops(const std::vector<StopRecord>& stops, size_t threads_count);
+
+		void AddBuses(const std::vector<BusRecord>& buses, size_t threads_count);
+
+		void AddDistances(const std::vector<DistanceRecord>& distances, size_t threads_count);
+
 		const domain::Stop* FindStop(std::string_view stop_name) const;
 
 		const domain::Bus* FindBus(std::string_view bus_name) const;
 
+		// Задаёт модель географических расстояний для длин маршрутов; действует при следующем BuildIndexes
+		void SetDistanceModel(geo::DistanceModel distance_model);
+
+		geo::DistanceModel GetDistanceModel() const;
+
+		// Строит индексы, которым нужны все остановки, маршруты и расстояния между остановками.
+		// Вызывается после загрузки базы, до обработки запросов
+		void BuildIndexes();
+
+		// Строит индексы, как BuildIndexes(), но длины маршрутов, не зависящих от changes, переносит
+		// из previous. Маршрут зависит от своих остановок и расстояний между соседними из них:
+		// затронутые маршруты находятся по матрице "остановка × маршрут". Возвращает число пересчитанных маршрутов
+		size_t BuildIndexes(const TransportCatalogue& previous, const CatalogueChanges& changes);
+
+		// Бросает std::out_of_range с названиями остановок, если между соседними остановками маршрута
+		// нет расстояния; так же поступает GetDistanceAlongBus
 		domain::Bus_Information GetBusInformation(const domain::Bus* bus_iterator) const;
 
+		// Бросает std::out_of_range, как GetBusInformation, если расстояния нет у маршрута,
+		// длины которого в previous были посчитаны или которого там не было. Маршрут, у которого расстояния
+		// не было и раньше, не мешает изменениям, не касающимся его
+		void CheckRouteLengths(const TransportCatalogue& previous) const;
+
+		// Возвращает расстояние вдоль маршрута от одной остановки до другой
+		// или std::nullopt, если какой-то из остановок нет на маршруте
+		std::optional<domain::Route_Segment_Information> GetDistanceAlongBus(const domain::Bus* bus_iterator,
+		                                                                     const domain::Stop* from_stop,
+		                                                                     const domain::Stop* to_stop) const;
+
+		// Возвращает упорядоченные названия маршрутов, проходящих не дальше radius метров от точки
+		std::vector<std::string_view> GetBusesNearPoint(geo::Coordinates point, double radius) const;
+
+		// Ищет остановки и маршруты по началу или целому названию с допустимым числом опечаток
+		std::vector<search_index::SearchResult> SearchNames(std::string_view query, int max_errors,
+		                                                    bool is_prefix, size_t limit) const;
+
 		std::set<std::string_view> GetBusesForStop(std::string_view stop_name) const;
 
+		// Возвращает маршруты, напрямую связывающие две остановки, и остановки,
+		// на которых можно пересесть с маршрута первой остановки на маршрут второй
+		domain::Transfers_Information GetTransfersBetweenStops(const domain::Stop* from_stop,
+		                                                       const domain::Stop* to_stop) const;
+
+		// Расстояния до остановок, которых нет в справочнике, пропускаются: на маршрутах таких остановок
+		// быть не может, а хранить расстояние с пустым концом нельзя
 		void AddDistanceBetweenStops(const std::string& stop, const DistancesContainer& distances_container);
 
-		int GetDistanceBetweenStops(const domain::Stop* from_stop, const domain::Stop* to_stop) const;
+		void SetDistanceBetweenStops(const domain::Stop* from_stop, const domain::Stop* to_stop, int distance);
+
+		// Расстояние от одной остановки до другой, а если его нет - в обратную сторону
+		std::optional<int> GetDistanceBetweenStops(const domain::Stop* from_stop, const domain::Stop* to_stop) const;
 
 		const std::unordered_map<std::string_view, const domain::Bus*>& GetBuses() const;
 
 		const std::unordered_map<std::string_view, const domain::Stop*>& GetStops() const;
 
+		// Остановки и маршруты в порядке добавления: индекс элемента совпадает с stop_id/bus_id
+		const std::deque<domain::Stop>& GetStopsList() const;
+
+		const std::deque<domain::Bus>& GetBusesList() const;
+
+		const DistancesMap& GetDistances() const;
+
+		// Оценка памяти по структурам справочника; память строк названий учитывается в stops_ и buses_
+		memory_usage::Report MemoryUsage() const;
+
 	private:
 		std::deque<domain::Stop> stops_;
 		std::unordered_map<std::string_view, const domain::Stop*> stopname_to_stop_;
 		std::deque<domain::Bus> buses_;
 		std::unordered_map<std::string_view, const domain::Bus*> busname_to_bus_;
 		std::unordered_map<std::string_view, std::set<std::string_view>> buses_for_stopname_;
-		std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, PairStopsHasher> distances_between_stops_;
+		DistancesMap distances_between_stops_;
+		// Матрица инцидентности "остановка × маршрут", индексируется по stop_id
+		std::vector<BusesBitmap> buses_bitmap_for_stop_;
+		// Тригонометрия координат остановок, вычисленная при добавлении; индексируется по stop_id
+		std::vector<geo::PreparedCoordinates> prepared_coordinates_;
+		geo::DistanceModel distance_model_ = geo::DistanceModel::SPHERICAL_COSINES;
+		// Накопленные длины маршрутов, индексируются по bus_id
+		std::vector<RouteLengths> routes_lengths_;
+		// Отрезки линий маршрутов, идентификатор ломаной - bus_id
+		spatial_index::SegmentIndex buses_segments_index_;
+		// Названия остановок и маршрутов для поиска по префиксу и с опечатками
+		search_index::NameIndex names_index_;
+
+		const RouteLengths& GetRouteLengths(const domain::Bus* bus_iterator) const;
+
+		// Строит индексы; непустой reusable_lengths[bus_id] - уже посчитанные длины маршрута,
+		// позиции остановок в которых годятся, только если are_stop_ids_kept
+		void BuildIndexes(const std::vector<const RouteLengths*>& reusable_lengths, bool are_stop_ids_kept);
+
+		RouteLengths ComputeRouteLengths(const domain::Bus& bus) const;
 	};
 }
\ No newline at end of file